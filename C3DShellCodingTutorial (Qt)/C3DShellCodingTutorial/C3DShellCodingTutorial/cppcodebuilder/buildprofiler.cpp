@@ -0,0 +1,70 @@
+﻿#include "buildprofiler.h"
+#include "globaldef.h"
+
+BuildProfiler& BuildProfiler::instance()
+{
+    static BuildProfiler singleton;
+    return singleton;
+}
+
+qint64 BuildProfiler::elapsed() const
+{
+    return m_clock.isValid() ? m_clock.nsecsElapsed() : 0;
+}
+
+void BuildProfiler::beginRun()
+{
+    m_clock.start();
+    m_openSpans.clear();
+
+    ProfileRun run;
+    run.started = QDateTime::currentDateTime();
+    m_runs.prepend(run);
+    while (m_runs.size() > g_kDefaultProfilerHistorySize)
+        m_runs.removeLast();
+    emit runStarted();
+}
+
+void BuildProfiler::begin(const QString& name)
+{
+    if (!m_runs.isEmpty())
+        m_openSpans.insert(name, elapsed());
+}
+
+void BuildProfiler::end(const QString& name)
+{
+    auto it = m_openSpans.find(name);
+    if (it == m_openSpans.end())
+        return;
+
+    const qint64 start = it.value();
+    m_openSpans.erase(it);
+    m_runs.first().spans.push_back({ name, start, elapsed() - start });
+    emit runChanged();
+}
+
+bool BuildProfiler::isOpen(const QString& name) const
+{
+    return m_openSpans.contains(name);
+}
+
+void BuildProfiler::addSpan(const QString& name, qint64 start, qint64 duration)
+{
+    if (m_runs.isEmpty())
+        return;
+    m_runs.first().spans.push_back({ name, start, duration });
+    emit runChanged();
+}
+
+void BuildProfiler::addKernelTiming(const KernelTiming& timing)
+{
+    if (m_runs.isEmpty())
+        return;
+    m_runs.first().kernelTimings.push_back(timing);
+    emit runChanged();
+}
+
+const QList<ProfileRun>& BuildProfiler::runs() const
+{
+    return m_runs;
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+#define PROFILER BuildProfiler::instance()
+
+// A measured step of a run, in nanoseconds from the start of the run
+struct ProfileSpan
+{
+    QString name;
+    qint64 start = 0;
+    qint64 duration = 0;
+};
+
+// A kernel operation the user code called, as the kernel time test reports it
+struct KernelTiming
+{
+    QString name;
+    double milliseconds = 0.0;
+    int count = 0;
+};
+
+struct ProfileRun
+{
+    QDateTime started;
+    QVector<ProfileSpan> spans;
+    QVector<KernelTiming> kernelTimings;
+};
+
+// Timeline of each Display, from the build script to the first frame of the
+// scene. The steps are measured with the monotonic clock by whoever does
+// them; the last runs are kept for comparison.
+class BuildProfiler : public QObject
+{
+    Q_OBJECT
+public:
+    static BuildProfiler& instance();
+
+    void beginRun();
+    // Spans are matched by name; ending a span that was not begun does nothing.
+    void begin(const QString& name);
+    void end(const QString& name);
+    bool isOpen(const QString& name) const;
+    // A span measured elsewhere, e.g. in C3DCodeHost, placed by the caller.
+    void addSpan(const QString& name, qint64 start, qint64 duration);
+    void addKernelTiming(const KernelTiming& timing);
+
+    // Nanoseconds since beginRun
+    qint64 elapsed() const;
+    // The newest run first
+    const QList<ProfileRun>& runs() const;
+
+signals:
+    void runStarted();
+    void runChanged();
+
+private:
+    BuildProfiler() = default;
+
+    QList<ProfileRun> m_runs;
+    QHash<QString, qint64> m_openSpans;
+    QElapsedTimer m_clock;
+};
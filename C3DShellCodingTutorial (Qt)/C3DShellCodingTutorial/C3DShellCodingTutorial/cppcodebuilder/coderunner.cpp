@@ -0,0 +1,272 @@
+﻿#include <climits>
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QSharedMemory>
+
+#include <io_tape.h>
+#include <io_memory_buffer.h>
+
+#include "coderunner.h"
+#include "codehostprotocol.h"
+#include "buildprofiler.h"
+
+CodeRunner::CodeRunner(QObject* parent)
+    : QObject(parent)
+    , m_pHost(new QProcess(this))
+{
+    m_watchdog.setSingleShot(true);
+    connect(&m_watchdog, &QTimer::timeout, this, &CodeRunner::timedOut);
+    connect(m_pHost, &QProcess::readyReadStandardOutput, this, &CodeRunner::readReplies);
+    connect(m_pHost, &QProcess::readyReadStandardError, this, &CodeRunner::readOutput);
+    connect(m_pHost, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+        this, &CodeRunner::hostFinished);
+}
+
+CodeRunner::~CodeRunner()
+{
+    m_pHost->blockSignals(true);
+    if (m_pHost->state() != QProcess::NotRunning)
+    {
+        m_pHost->closeWriteChannel();
+        if (!m_pHost->waitForFinished(1000))
+            m_pHost->kill();
+        m_pHost->waitForFinished(1000);
+    }
+    for (const Model& model : m_result.models)
+        ::ReleaseItem(model.item);
+}
+
+bool CodeRunner::start()
+{
+    if (m_pHost->state() != QProcess::NotRunning)
+        return true;
+
+    m_pending.clear();
+    m_output.clear();
+    m_pHost->start(QCoreApplication::applicationDirPath() + "/" + g_kDefaultCodeHostFileName, QStringList());
+    return m_pHost->waitForStarted();
+}
+
+void CodeRunner::run(const QString& libraryName, int timeout)
+{
+    if (!start())
+    {
+        emit failed(tr("Cannot start %1").arg(g_kDefaultCodeHostFileName));
+        return;
+    }
+
+    m_key = QString("c3d-results-%1-%2").arg(QCoreApplication::applicationPid()).arg(++m_runCount);
+    m_pHost->write(QString("run %1\t%2\n").arg(libraryName, m_key).toUtf8());
+    m_runStart = PROFILER.elapsed();
+    m_isRunning = true;
+    m_watchdog.start(timeout);
+}
+
+bool CodeRunner::isRunning() const
+{
+    return m_isRunning;
+}
+
+CodeRunResult CodeRunner::takeResult()
+{
+    CodeRunResult result;
+    std::swap(result, m_result);
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// Only whole lines go to the console, so a chunk of the pipe does not split one.
+// ---
+void CodeRunner::readOutput()
+{
+    m_output += m_pHost->readAllStandardError();
+    const int end = m_output.lastIndexOf('\n');
+    if (end < 0)
+        return;
+
+    emit output(fromByteArray(m_output.left(end)));
+    m_output.remove(0, end + 1);
+}
+
+void CodeRunner::flushOutput()
+{
+    m_output += m_pHost->readAllStandardError();
+    if (m_output.endsWith('\n'))
+        m_output.chop(1);
+    if (!m_output.isEmpty())
+        emit output(fromByteArray(m_output));
+    m_output.clear();
+}
+
+void CodeRunner::readReplies()
+{
+    m_pending += m_pHost->readAllStandardOutput();
+    int end = m_pending.indexOf('\n');
+    while (end >= 0)
+    {
+        const QString reply = QString::fromUtf8(m_pending.left(end)).trimmed();
+        m_pending.remove(0, end + 1);
+        readReply(reply);
+        end = m_pending.indexOf('\n');
+    }
+}
+
+void CodeRunner::readReply(const QString& reply)
+{
+    if (!m_isRunning)
+        return;
+    if (reply.startsWith("span ") || reply.startsWith("kernel "))
+    {
+        readTiming(reply);
+        return;
+    }
+    m_isRunning = false;
+    m_watchdog.stop();
+    flushOutput();
+
+    const QStringList words = reply.split(' ');
+    if (words.value(0) == "done")
+    {
+        PROFILER.begin("Read results");
+        const bool isRead = readResults(words.value(2).toInt());
+        PROFILER.end("Read results");
+        m_result.isOk = isRead && words.value(1) == "1";
+        // the host drops its copy only now that ours is attached and read
+        m_pHost->write("release\n");
+        if (isRead)
+            emit finished(m_result.isOk);
+        else
+            emit failed(tr("Cannot read the results of the user code"));
+    }
+    else
+        emit failed(reply.mid(reply.indexOf(' ') + 1));
+}
+
+//-----------------------------------------------------------------------------
+// The host measures from the moment it read the request, which is taken for
+// the moment it was sent.
+// ---
+void CodeRunner::readTiming(const QString& reply)
+{
+    const int space = reply.indexOf(' ');
+    const QStringList fields = reply.mid(space + 1).split('\t');
+    if (fields.size() != 3)
+        return;
+
+    if (reply.startsWith("span "))
+        PROFILER.addSpan(fields[0], m_runStart + fields[1].toLongLong(), fields[2].toLongLong());
+    else
+        PROFILER.addKernelTiming({ fields[0], fields[1].toDouble(), fields[2].toInt() });
+}
+
+//-----------------------------------------------------------------------------
+// The segment is read in place; the kernel reads the items from the stream
+// the host left in it. Every range and offset the header and the records give
+// is checked against the size first, a block that does not fit is rejected.
+// ---
+bool CodeRunner::readResults(int size)
+{
+    using namespace CodeHost;
+
+    for (const Model& model : m_result.models)
+        ::ReleaseItem(model.item);
+    m_result = CodeRunResult();
+
+    QSharedMemory memory(m_key);
+    if (!memory.attach(QSharedMemory::ReadOnly))
+        return false;
+
+    const char* pData = static_cast<const char*>(memory.constData());
+    ResultHeader header;
+    if (size < int(sizeof(header)) || memory.size() < size)
+        return false;
+    std::memcpy(&header, pData, sizeof(header));
+    if (header.magic != kResultMagic || header.version != kResultVersion)
+        return false;
+
+    const uint64_t blockSize = uint64_t(size);
+    auto fits = [](uint64_t offset, uint64_t length, uint64_t end)
+    {
+        return offset <= end && length <= end - offset;
+    };
+    const uint64_t textCount = header.messageCount + 2 * uint64_t(header.messageBoxCount);
+    const uint64_t textRecordsOffset = sizeof(ResultHeader) + header.modelCount * uint64_t(sizeof(ModelRecord));
+    if (!fits(sizeof(ResultHeader), header.modelCount * uint64_t(sizeof(ModelRecord)), blockSize) ||
+        !fits(textRecordsOffset, textCount * sizeof(TextRecord), blockSize) ||
+        !fits(header.textOffset, header.textSize, blockSize) ||
+        !fits(header.itemsOffset, header.itemsSize, blockSize))
+        return false;
+
+    const ModelRecord* pModels = reinterpret_cast<const ModelRecord*>(pData + sizeof(ResultHeader));
+    const TextRecord* pTexts = reinterpret_cast<const TextRecord*>(pData + textRecordsOffset);
+    for (uint64_t i = 0; i < textCount; ++i)
+    {
+        if (!fits(pTexts[i].offset, pTexts[i].size, header.textSize) || pTexts[i].size > uint64_t(INT_MAX))
+            return false;
+    }
+    const char* pArena = pData + header.textOffset;
+    auto text = [pArena](const TextRecord& record)
+    {
+        return QString::fromUtf8(pArena + record.offset, int(record.size));
+    };
+
+    for (uint32_t i = 0; i < header.messageCount; ++i)
+        m_result.messages.push_back(text(*pTexts++));
+    for (uint32_t i = 0; i < header.messageBoxCount; ++i, pTexts += 2)
+        m_result.messageBoxes.push_back({ text(pTexts[0]), text(pTexts[1]) });
+
+    if (header.modelCount == 0)
+        return true;
+
+    // the kernel stream carries its own length, it must not run past the range
+    membuf memBuf;
+    if (header.itemsSize == 0 || !memBuf.fromMemory(pData + header.itemsOffset) ||
+        memBuf.getMemLen() > header.itemsSize)
+        return false;
+    reader::reader_ptr in = reader::CreateMemReader(memBuf, io::in);
+    if (!in || !in->good())
+        return false;
+
+    for (uint32_t i = 0; i < header.modelCount; ++i, ++pModels)
+    {
+        MbItem* pItem = nullptr;
+        *in >> pItem;
+        if (pItem == nullptr || !in->good())
+            return false;
+
+        Model model;
+        model.style.set(pModels->style, pModels->width, pModels->color);
+        model.item = pItem;
+        ::AddRefItem(pItem);
+        m_result.models.push_back(model);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// A host that died in a run took the user code down with it; the next one is
+// started right away so the next run does not wait for it.
+// ---
+void CodeRunner::hostFinished()
+{
+    if (!m_isRunning)
+        return;
+    m_isRunning = false;
+    m_watchdog.stop();
+    flushOutput();
+
+    emit failed(tr("The user code crashed."));
+    start();
+}
+
+void CodeRunner::timedOut()
+{
+    m_isRunning = false;
+    m_pHost->kill();
+    m_pHost->waitForFinished(1000);
+    flushOutput();
+
+    emit failed(tr("The user code did not finish in time and was stopped."));
+    start();
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QVector>
+#include <QPair>
+
+#include "globaldef.h"
+
+// Results of one run of the user code
+struct CodeRunResult
+{
+    bool isOk = false;
+    QVector<Model> models; // each item holds one reference
+    QVector<QString> messages;
+    QVector<QPair<QString, QString>> messageBoxes;
+};
+
+// Runs the compiled user code in the C3DCodeHost process and takes the results
+// over from its shared memory. A host that crashes or runs past the time limit
+// is killed and the next one started at once, so the application only loses
+// the run.
+class CodeRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CodeRunner(QObject* parent = nullptr);
+    ~CodeRunner() override;
+
+    // Starts the host ahead of the first run.
+    bool start();
+    void run(const QString& libraryName, int timeout);
+    bool isRunning() const;
+    // The results of the last finished run; their item references go to the caller.
+    CodeRunResult takeResult();
+
+signals:
+    void finished(bool isOk);
+    void failed(const QString& reason);
+    // Whatever the user code printed
+    void output(const QString& text);
+
+private:
+    void readReplies();
+    void readReply(const QString& reply);
+    void readTiming(const QString& reply);
+    void readOutput();
+    void flushOutput();
+    void hostFinished();
+    void timedOut();
+    bool readResults(int size);
+
+    QProcess* m_pHost;
+    QTimer m_watchdog;
+    QByteArray m_pending; // replies after the last full line
+    QByteArray m_output;  // printed after the last full line
+    QString m_key;        // of the shared memory of the run
+    qint64 m_runStart = 0; // of the run in the timeline of BuildProfiler
+    CodeRunResult m_result;
+    int m_runCount = 0;
+    bool m_isRunning = false;
+};
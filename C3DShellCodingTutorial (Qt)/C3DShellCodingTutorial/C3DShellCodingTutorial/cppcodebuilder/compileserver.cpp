@@ -0,0 +1,132 @@
+﻿#include "compileserver.h"
+#include "toolchain.h"
+#include "globaldef.h"
+
+CompileServer::CompileServer(QObject* parent)
+    : QObject(parent)
+    , m_pProcess(new QProcess(this))
+{
+    // diagnostics go to either stream, their order matters
+    m_pProcess->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_pProcess, &QProcess::readyReadStandardOutput, this, &CompileServer::readOutput);
+    connect(m_pProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+        this, &CompileServer::processFinished);
+}
+
+CompileServer::~CompileServer()
+{
+    stop();
+}
+
+bool CompileServer::start(const Toolchain& toolchain)
+{
+    m_pToolchain = &toolchain;
+    if (isRunning() && m_compilerPath == toolchain.compilerPath())
+        return true;
+
+    stop();
+    m_compilerPath = toolchain.compilerPath();
+    m_pProcess->start(toolchain.shellProgram(), toolchain.shellArguments());
+    if (!m_pProcess->waitForStarted())
+        return false;
+
+    // answered like a build script, so the environment is ready once the marker comes
+    Job environment{ toolchain.environmentCommands(), nextMarker() };
+    environment.commands << toolchain.readyCommand(QString::fromLatin1(environment.marker));
+    m_isStarting = true;
+    send(environment);
+    return true;
+}
+
+void CompileServer::stop()
+{
+    if (!isRunning())
+        return;
+
+    m_queue.clear();
+    m_marker.clear();
+    m_pending.clear();
+    m_pProcess->blockSignals(true);
+    m_pProcess->write("exit\n");
+    m_pProcess->closeWriteChannel();
+    if (!m_pProcess->waitForFinished(1000))
+        m_pProcess->kill();
+    m_pProcess->waitForFinished(1000);
+    m_pProcess->blockSignals(false);
+}
+
+bool CompileServer::isRunning() const
+{
+    return m_pProcess->state() != QProcess::NotRunning;
+}
+
+void CompileServer::run(const QString& scriptName)
+{
+    Job job;
+    job.marker = nextMarker();
+    job.commands = m_pToolchain->runCommands(scriptName, QString::fromLatin1(job.marker));
+    if (m_marker.isEmpty())
+        send(job);
+    else
+        m_queue.enqueue(job);
+}
+
+QByteArray CompileServer::nextMarker()
+{
+    return QByteArray("#c3d-build-done-") + QByteArray::number(++m_jobCount) + '#';
+}
+
+void CompileServer::send(const Job& job)
+{
+    m_marker = job.marker;
+    m_pProcess->write(job.commands.join('\n').toUtf8() + '\n');
+}
+
+void CompileServer::readOutput()
+{
+    m_pending += m_pProcess->readAllStandardOutput();
+    int end = m_pending.indexOf('\n');
+    while (end >= 0)
+    {
+        QByteArray line = m_pending.left(end);
+        m_pending.remove(0, end + 1);
+        if (line.endsWith('\r'))
+            line.chop(1);
+        readLine(line);
+        end = m_pending.indexOf('\n');
+    }
+}
+
+void CompileServer::readLine(const QByteArray& line)
+{
+    if (m_marker.isEmpty() || !line.startsWith(m_marker))
+    {
+        if (!m_isStarting)
+            emit outputLine(fromByteArray(line));
+        return;
+    }
+
+    const int exitCode = line.mid(m_marker.size()).trimmed().toInt();
+    m_marker.clear();
+    if (m_isStarting)
+    {
+        m_isStarting = false;
+        emit ready();
+    }
+    else
+        emit finished(exitCode);
+
+    if (!m_queue.isEmpty() && m_marker.isEmpty())
+        send(m_queue.dequeue());
+}
+
+void CompileServer::processFinished()
+{
+    const bool wasBusy = !m_marker.isEmpty() || !m_queue.isEmpty();
+    m_queue.clear();
+    m_marker.clear();
+    m_pending.clear();
+    m_isStarting = false;
+    if (wasBusy)
+        emit crashed();
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QProcess>
+#include <QQueue>
+#include <QStringList>
+
+class Toolchain;
+
+// Resident shell of the toolchain. Its environment is set up once when it
+// starts, every build script then runs in it, so a build pays neither for a new
+// shell nor for vcvars64.bat. The output of a script comes line by line while
+// it runs; the scripts queued meanwhile run one after another.
+class CompileServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CompileServer(QObject* parent = nullptr);
+    ~CompileServer() override;
+
+    // Restarts the shell when it runs for another compiler or has died.
+    // The toolchain is kept until the next start.
+    bool start(const Toolchain& toolchain);
+    void stop();
+    bool isRunning() const;
+
+    void run(const QString& scriptName);
+
+signals:
+    // The environment of a new shell is set up.
+    void ready();
+    void outputLine(const QString& line);
+    void finished(int exitCode);
+    // The shell died while a script ran; the queued scripts are dropped.
+    void crashed();
+
+private:
+    struct Job
+    {
+        QStringList commands;
+        QByteArray marker; // printed with the exit code when the script is done
+    };
+
+    void readOutput();
+    void readLine(const QByteArray& line);
+    void processFinished();
+    void send(const Job& job);
+    QByteArray nextMarker();
+
+    QProcess* m_pProcess;
+    const Toolchain* m_pToolchain = nullptr;
+    QString m_compilerPath;
+    QQueue<Job> m_queue;
+    QByteArray m_pending;      // output after the last full line
+    QByteArray m_marker;       // of the job that runs
+    bool m_isStarting = false; // the output of the environment commands is dropped
+    int m_jobCount = 0;
+};
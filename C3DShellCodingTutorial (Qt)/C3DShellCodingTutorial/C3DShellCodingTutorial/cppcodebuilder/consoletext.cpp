@@ -1,15 +1,22 @@
 ﻿#include "consoletext.h"
+#include "globaldef.h"
 #include <QFontDatabase>
 #include <QTextBlock>
+#include <QScrollBar>
 
 ConsoleText::ConsoleText(QWidget* parent)
-    : QTextEdit(parent)
+    : QPlainTextEdit(parent)
     , m_stdColor(Qt::black)
     , m_errColor(Qt::red)
     , m_warningColor(Qt::darkYellow)
     , m_completionColor(Qt::darkGreen)
+    , m_pending(g_kDefaultConsoleLineLimit)
 {
     setReadOnly(true);
+    setMaximumBlockCount(g_kDefaultConsoleLineLimit);
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ConsoleText::flush);
     int id = QFontDatabase::addApplicationFont(":/res/fonts/FiraCode-Retina.ttf");
     QString family = QFontDatabase::applicationFontFamilies(id).at(0);
     QFont f(family);
@@ -64,10 +71,48 @@ void ConsoleText::setCompletionColor(QColor c)
 
 void ConsoleText::addText(const QString& result, const QColor& color)
 {
-    setTextColor(color);
-    append(result);
+    // the oldest lines fall out of the cache when it is full
+    for (const QString& line : result.split('\n'))
+        m_pending.append({ line, color });
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+// Lines of one colour go in as one insert. The view follows the output only
+// when it was scrolled to the end.
+// ---
+void ConsoleText::flush()
+{
+    if (m_pending.isEmpty())
+        return;
+
+    QScrollBar* pScrollBar = verticalScrollBar();
+    const bool isAtEnd = pScrollBar->value() == pScrollBar->maximum();
+
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.beginEditBlock();
+    bool isFirst = document()->isEmpty();
+    while (!m_pending.isEmpty())
+    {
+        const QColor color = m_pending.first().color;
+        QString text;
+        while (!m_pending.isEmpty() && m_pending.first().color == color)
+        {
+            if (!isFirst)
+                text.append('\n');
+            text.append(m_pending.takeFirst().text);
+            isFirst = false;
+        }
+        QTextCharFormat format;
+        format.setForeground(color);
+        cursor.insertText(text, format);
+    }
+    cursor.endEditBlock();
 
-    moveCursor(QTextCursor::End);
+    if (isAtEnd)
+        pScrollBar->setValue(pScrollBar->maximum());
 }
 
 void ConsoleText::addText(const QString& result, ResultType type)
@@ -107,5 +152,7 @@ void ConsoleText::mouseDoubleClickEvent(QMouseEvent* /*e*/)
 
 void ConsoleText::clear()
 {
-    QTextEdit::clear();
+    m_pending.clear();
+    m_flushTimer.stop();
+    QPlainTextEdit::clear();
 }
\ No newline at end of file
@@ -1,9 +1,14 @@
 ﻿#pragma once
 
-#include <QTextEdit>
+#include <QPlainTextEdit>
+#include <QContiguousCache>
+#include <QTimer>
 #include <QDebug>
 
-class ConsoleText : public QTextEdit
+// Log of the builder and of the scene. Appends are queued and written once per
+// turn of the event loop; the queue and the document keep the last
+// g_kDefaultConsoleLineLimit lines only, so a flood of output costs at most that.
+class ConsoleText : public QPlainTextEdit
 {
     Q_OBJECT
 
@@ -30,8 +35,18 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent* e) override;
 
 private:
+    struct Line
+    {
+        QString text;
+        QColor color;
+    };
+
+    void flush();
+
     QColor m_stdColor, m_errColor, m_warningColor, m_completionColor;
     QString m_currentLine;
+    QContiguousCache<Line> m_pending;
+    QTimer m_flushTimer;
     
 public slots:
     void addText(const QString& result, ResultType t = ResultType::Standart);
@@ -1,184 +1,452 @@
 ﻿#include <QApplication>
-#include <QThread>
 #include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
 #include <QMessageBox>
 #include <QSettings>
 #include <QRegularExpression>
+#include <QTimer>
 
 #include "storagelocation.h"
 #include "cppcodebuilder.h"
-#include "worker.h"
+#include "toolchain.h"
+#include "compileserver.h"
+#include "buildprofiler.h"
 #include "globaldef.h"
 
 CppCodeBuilder::CppCodeBuilder(QWidget* parent)
     : QWidget(parent)
+    , m_pServer(new CompileServer(this))
+    , m_pRunner(new CodeRunner(this))
     , exePath(QApplication::applicationDirPath())
-    , consoleProcess(new QProcess(this))
-    , m_dll()
 {
-    connect(consoleProcess, &QProcess::readyReadStandardOutput,
-        this, &CppCodeBuilder::readConsoleOutput);
-    connect(consoleProcess, &QProcess::readyReadStandardError,
-        this, &CppCodeBuilder::readConsoleError);
-    connect(consoleProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-        this, &CppCodeBuilder::finishedCompilation);
+    connect(m_pServer, &CompileServer::outputLine, this, &CppCodeBuilder::readCompilerLine);
+    connect(m_pServer, &CompileServer::finished, this, &CppCodeBuilder::finishedCompilation);
+    connect(m_pServer, &CompileServer::crashed, this, &CppCodeBuilder::compilationCrashed);
+    connect(m_pServer, &CompileServer::ready, this, [] { PROFILER.end("Shell environment"); });
+
+    connect(m_pRunner, &CodeRunner::finished, this, &CppCodeBuilder::runFinished);
+    connect(m_pRunner, &CodeRunner::failed, this, &CppCodeBuilder::runFailed);
+    connect(m_pRunner, &CodeRunner::output, [this](const QString& text)
+    {
+        emit sendToConsole(text, ConsoleText::ResultType::Standart);
+    });
+
+    QTimer::singleShot(0, this, &CppCodeBuilder::warmUp);
+}
+
+CppCodeBuilder::~CppCodeBuilder()
+{
+    releaseRunResult();
+}
 
-    QFile initCompiler(APP.tempDir() + "/" + g_kDefaultBuilderInitFileName);
+//-----------------------------------------------------------------------------
+// The compiler may be chosen in CompilerSearch after the builder was made,
+// so the settings are read again before each build. Returns true when the
+// toolchain was replaced.
+// ---
+bool CppCodeBuilder::updateToolchain()
+{
+    QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
+    const QString compilerPath = settings.value("Build/CompilerPath").toString();
+    if (m_toolchain != nullptr && (compilerPath.isEmpty() || compilerPath == m_toolchain->compilerPath()))
+        return false;
+    m_toolchain = Toolchain::create(compilerPath.isEmpty() ? Toolchain::defaultCompilerPath() : compilerPath);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Starts the compile server and builds the precompiled header and dllmain.cpp
+// in it while the first lesson is still being written.
+// ---
+void CppCodeBuilder::warmUp()
+{
+    m_pRunner->start();
+    updateToolchain();
+    if (!m_pServer->start(*m_toolchain))
+        return;
+
+    preparePrecompiledHeader();
+    const QString scriptName = APP.tempDir() + "/" + g_kDefaultBuilderWarmUpPrefix + m_toolchain->scriptFileName();
+    if (!writeBuildScript(scriptName, { APP.userDir() + "/" + g_kDefaultBuilderUserMainFileName }, false))
+        return;
+
+    m_isWarmingUp = true;
+    m_pServer->run(scriptName);
+}
+
+bool CppCodeBuilder::compileCode()
+{
+    if (!m_build.isLive)
+        emit startWork();
+   
+    // a new compiler restarts the shell, the warm-up dies with it
+    const bool isNewShell = updateToolchain() || !m_pServer->isRunning();
+    if (isNewShell)
+    {
+        m_isWarmingUp = false;
+        PROFILER.begin("Shell environment");
+    }
+    else if (m_isWarmingUp)
+        PROFILER.begin("Waiting for warm-up");
+    if (!m_pServer->start(*m_toolchain))
+        return false;
+
+    preparePrecompiledHeader();
+    const QString scriptName = APP.tempDir() + "/" + m_toolchain->scriptFileName();
+    const QStringList sources = { APP.userDir() + "/" + g_kDefaultBuilderUserMainFileName, APP.builderUserFileName() };
+    if (!writeBuildScript(scriptName, sources, true))
+        return false;
+
+    m_isCompiling = true;
+    m_pServer->run(scriptName);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Diagnostics mark the editor as soon as the compiler prints them, the console
+// gets the whole output once the build failed.
+// ---
+void CppCodeBuilder::readCompilerLine(const QString& line)
+{
+    if (m_isWarmingUp)
+        return;
+
+    if (line.startsWith(g_kDefaultBuilderPhaseMarker))
+    {
+        endPhase();
+        m_phase = line.mid(g_kDefaultBuilderPhaseMarker.size()).trimmed();
+        PROFILER.begin(m_phase);
+        return;
+    }
+
+    m_consoleOutput.append(line).append('\n');
+
+    QString text(line);
+    text.remove(APP.builderUserFileName());
+    const auto match = m_toolchain->diagnosticPattern().match(text);
+    if (!match.hasMatch())
+        return;
+
+    QVector<QPair<int, QString>> errors{ { match.captured(1).toInt(), match.captured(2) } };
+    m_errorsList += errors;
+    // the editor has moved on from the code of a stale build
+    if (!m_build.isLive || !m_pendingBuild)
+        emit signalErrorsList(m_currentTextEdit, errors);
+}
+
+//-----------------------------------------------------------------------------
+// Writes a build script of the toolchain. Only the sources without a cached object are
+// compiled, so an unchanged dllmain.cpp or a lesson built before just links.
+// ---
+bool CppCodeBuilder::writeBuildScript(const QString& scriptName, const QStringList& sources, bool link)
+{
+    QFile initCompiler(scriptName);
     QTextStream txtStream(&initCompiler);
     txtStream.setCodec("UTF-8");
 
-    if (initCompiler.open(QIODevice::WriteOnly))
+    if (!initCompiler.open(QIODevice::WriteOnly))
+        return false;
+
+    m_toolchain->writePrologue(txtStream);
+    // setup.h and c3dAll.h are parsed once into the precompiled header,
+    // preparePrecompiledHeader() deletes it when it gets stale
+    m_toolchain->writePhase(txtStream, "Precompiled header");
+    m_toolchain->writePrecompile(txtStream);
+
+    QVector<CompileJob> jobs;
+    QStringList objects;
+    for (const QString& source : sources)
+    {
+        const QString object = cachedObjectName(source);
+        if (!QFile::exists(object) || !m_toolchain->isObjectCurrent(object))
+            jobs.push_back({ source, object });
+        objects << object;
+    }
+    if (!jobs.isEmpty())
+        m_toolchain->writePhase(txtStream, "Compile");
+    m_toolchain->writeCompile(txtStream, jobs);
+    if (link)
     {
-        txtStream << QString("chcp 65001\r\n");
+        m_toolchain->writePhase(txtStream, "Link");
+        m_toolchain->writeLink(txtStream, objects);
+    }
 
-        QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
-        auto compilerPath = settings.value("Build/CompilerPath", R"_(C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary\Build\vcvars64.bat)_").toString().replace("\\", "\\\\");
+    initCompiler.close();
+    return true;
+}
 
-        txtStream << QString("@call \"%1\"\r\n").arg(compilerPath);
-        txtStream << QString("@cd \"%1\"\r\n").arg(APP.tempDir());
+//-----------------------------------------------------------------------------
+// An object is keyed by its source and by the precompiled header hash, which
+// already covers the headers it can include and the compiler flags.
+// ---
+QString CppCodeBuilder::cachedObjectName(const QString& sourceName) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QFile source(sourceName);
+    if (source.open(QIODevice::ReadOnly))
+        hash.addData(&source);
+    hash.addData(m_pchHash);
+    return APP.objectCacheDir() + "/" + m_toolchain->objectFileName(QString::fromLatin1(hash.result().toHex()));
+}
 
-        txtStream << QString("cl /UTF-8 /Fo\"%6\"\\ -c /nologo /TP -DUNICODE -D_UNICODE /DWIN32 /D_WINDOWS /GR /EHsc ").arg(APP.tempDir());
-#ifdef _DEBUG
-        txtStream << QString("/Zi /Ob0 /Od /RTC1 /W4 /D_DEBUG /D_DRAWGI /MP /bigobj -MDd -std:c++14 ");
-#else
-        txtStream << QString("/O2 /Ob2 -DNDEBUG /W4 /MD -std:c++14 ");
-#endif // DEBUG
-        txtStream << QString("/I \"%1\" /I \"%2\" \"%3\" \"%4\" && link \"%6\\dllmain.obj\" \"%6\\code.obj\" /out:\"%6\\dllmain.dll\" /dll /machine:x64 /INCREMENTAL:NO \"%5\"")
-        /*%1*/.arg(APP.kernelDir())
-        /*%2*/.arg(APP.userDir())
-        /*%3*/.arg(APP.userDir() + "/" + g_kDefaultBuilderUserMainFileName)
-        /*%4*/.arg(APP.builderUserFileName())
-        /*%5*/.arg(APP.userDir() + "/c3d.lib")
-        /*%6*/.arg(APP.tempDir());
+//-----------------------------------------------------------------------------
+// Writes the sources of the precompiled header and drops the header made for
+// other kernel headers, user headers or compiler flags.
+// ---
+void CppCodeBuilder::preparePrecompiledHeader()
+{
+    QFile header(APP.tempDir() + "/" + g_kDefaultBuilderPchHeaderFileName);
+    if (!header.exists() && header.open(QIODevice::WriteOnly))
+    {
+        header.write("#pragma once\n#include \"setup.h\"\n#include \"c3dAll.h\"\n");
+        header.close();
+    }
 
-        initCompiler.close();
+    QFile source(APP.tempDir() + "/" + g_kDefaultBuilderPchSourceFileName);
+    if (!source.exists() && source.open(QIODevice::WriteOnly))
+    {
+        source.write(QString("#include \"%1\"\n").arg(g_kDefaultBuilderPchHeaderFileName).toUtf8());
+        source.close();
     }
 
+    const QString pchFileName = m_toolchain->precompiledHeaderFiles().first();
+    m_pchHash = precompiledHeaderHash();
+    QFile stamp(APP.tempDir() + "/" + g_kDefaultBuilderPchFileName + ".hash");
+    QByteArray storedHash;
+    if (stamp.open(QIODevice::ReadOnly))
+    {
+        storedHash = stamp.readAll();
+        stamp.close();
+    }
+
+    // objects built against a precompiled header only link with that one
+    QDir objectCache(APP.objectCacheDir());
+    if (storedHash == m_pchHash && QFile::exists(pchFileName))
+    {
+        objectCache.mkpath(".");
+        return;
+    }
+    objectCache.removeRecursively();
+    objectCache.mkpath(".");
+
+    for (const QString& fileName : m_toolchain->precompiledHeaderFiles())
+        QFile::remove(fileName);
+    if (stamp.open(QIODevice::WriteOnly))
+    {
+        stamp.write(m_pchHash);
+        stamp.close();
+    }
 }
 
-void CppCodeBuilder::readConsoleOutput()
+//-----------------------------------------------------------------------------
+// Names, sizes and times of the headers that go into the precompiled header;
+// reading them all would cost more than the compile it saves. Every header of
+// the user folder counts, not only setup.h and c3dAll.h: MSVC has no check of
+// its own, so an edited resultblock.h must drop the cached objects here.
+// ---
+QByteArray CppCodeBuilder::precompiledHeaderHash() const
 {
-    QString str = fromByteArray(consoleProcess->readAllStandardOutput());
-    m_consoleOutput.append(str);
-    //emit sendToConsole(str, ConsoleText::ResultType::Warning);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_toolchain->compilerPath().toUtf8());
+    hash.addData(m_toolchain->flags().toUtf8());
+
+    QFileInfoList headers = QDir(APP.kernelDir()).entryInfoList(QDir::Files, QDir::Name);
+    headers << QDir(APP.userDir()).entryInfoList({ "*.h", "*.hpp" }, QDir::Files, QDir::Name);
+    for (const QFileInfo& info : headers)
+    {
+        hash.addData(info.fileName().toUtf8());
+        const qint64 stamp[2] = { info.size(), info.lastModified().toMSecsSinceEpoch() };
+        hash.addData(reinterpret_cast<const char*>(stamp), sizeof(stamp));
+    }
+    return hash.result().toHex();
 }
 
-void CppCodeBuilder::readConsoleError()
+void CppCodeBuilder::receiveCode(const QString& txt, const QString& name)
 {
-    QString str = fromByteArray(consoleProcess->readAllStandardError());
-    m_consoleError.append(str);
-    emit sendToConsole(str, ConsoleText::ResultType::Error);
+    requestBuild({ txt, name, false });
 }
 
-bool CppCodeBuilder::compileCode()
+void CppCodeBuilder::receiveLiveCode(const QString& txt, const QString& name)
 {
-    emit startWork();
-   
-    releaseDll();
+    requestBuild({ txt, name, true });
+}
 
+//-----------------------------------------------------------------------------
+// The sources and the library are shared by all builds, so a build waits for
+// the one that runs. Only the newest waits; the one it replaced is dropped,
+// except that a Display the user asked for is never dropped for a live build.
+// ---
+void CppCodeBuilder::requestBuild(const BuildRequest& request)
+{
+    if (!isBusy())
+        startBuild(request);
+    else if (!request.isLive || !m_pendingBuild || m_pendingBuild->isLive)
+        m_pendingBuild = request;
+}
 
-    consoleProcess->start(QString("cmd.exe /c \"%1\"").arg(APP.tempDir() + "/" + g_kDefaultBuilderInitFileName));
+bool CppCodeBuilder::isBusy() const
+{
+    return m_isCompiling || m_pRunner->isRunning();
+}
 
-    return consoleProcess->waitForStarted();
+//-----------------------------------------------------------------------------
+// A live build is not shown once newer code waits or it ran out of its time
+// budget. The compiler is not stopped halfway, the resident shell would go
+// with it; the build is dropped at the next step instead.
+// ---
+bool CppCodeBuilder::isStale() const
+{
+    if (!m_build.isLive)
+        return false;
+    return m_pendingBuild.has_value() || m_buildClock.elapsed() > m_liveBudget;
 }
 
-void CppCodeBuilder::receiveCode(const QString& txt, const QString& name)
+void CppCodeBuilder::startBuild(const BuildRequest& request)
 {
-    m_currentTextEdit = name;
+    m_build = request;
+    m_buildClock.start();
+    m_currentTextEdit = request.editorName;
+    if (request.isLive)
+    {
+        // isStale asks for it at every step of the build
+        QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
+        m_liveBudget = settings.value("Build/LivePreviewBudget", g_kDefaultLivePreviewBudget).toInt() * 1000;
+    }
     QFile file(APP.builderUserFileName());
 
     if (file.open(QIODevice::WriteOnly)) {
-        file.write(txt.toUtf8());
+        file.write(request.code.toUtf8());
         file.close();
     }
 
-    emit clearConsole();
-    m_consoleError.clear();
+    PROFILER.beginRun();
     m_consoleOutput.clear();
+    m_errorsList.clear();
+    m_phase.clear();
 
-    emit sendToConsole(tr("Compilation started."), ConsoleText::ResultType::Complete);
+    // the console of a live build stays as it is until its results are shown
+    if (!m_build.isLive)
+    {
+        emit clearConsole();
+        emit sendToConsole(tr("Compilation started."), ConsoleText::ResultType::Complete);
+    }
 
     if (!compileCode())
     {
-        emit sendToConsole(tr("Compilation failed."), ConsoleText::ResultType::Error);
+        if (!m_build.isLive)
+            emit sendToConsole(tr("Compilation failed."), ConsoleText::ResultType::Error);
+        finishBuild();
+    }
+}
+
+void CppCodeBuilder::finishBuild()
+{
+    if (!m_build.isLive)
         emit finishWork();
+
+    if (m_pendingBuild)
+    {
+        const BuildRequest next = *m_pendingBuild;
+        m_pendingBuild.reset();
+        startBuild(next);
     }
 }
 
 
-void CppCodeBuilder::releaseDll()
+//-----------------------------------------------------------------------------
+// The scene takes its own references to the items it shows.
+// ---
+void CppCodeBuilder::releaseRunResult()
 {
-    if (m_dll.isLoaded())
+    for (const Model& model : m_runResult.models)
+        ::ReleaseItem(model.item);
+    m_runResult = CodeRunResult();
+}
+
+void CppCodeBuilder::runFinished(bool res)
+{
+    PROFILER.end("Run");
+    releaseRunResult();
+    m_runResult = m_pRunner->takeResult();
+
+    if (m_build.isLive)
     {
-        if (!m_dll.unload()) {
-            emit sendToConsole(tr("Unloading failed!"), ConsoleText::ResultType::Error);
+        if (!res || isStale())
+        {
+            finishBuild();
             return;
         }
+        // the scene is swapped only now, so messages go with its models
+        emit clearConsole();
     }
-}
 
-void CppCodeBuilder::workerFinished(bool res)
-{
     if (res)
     {
         emit sendToConsole(tr("Rendering..."), ConsoleText::ResultType::Complete);
-        emit drawObjects(m_objectsCollection);
+        emit drawObjects(m_runResult.models);
 
         emit sendToConsole(tr("Render completed."), ConsoleText::ResultType::Complete);
     }
     else
     {
         emit sendToConsole(tr("Rendering failed"), ConsoleText::ResultType::Error);
-        releaseDll();
     }
 
-    for (const QString& msg : m_messages)
+    // one signal for all, the console splits them into lines again
+    QString messages;
+    for (const QString& msg : m_runResult.messages)
     {
-        emit sendToSceneMessage(msg);
+        if (!messages.isEmpty())
+            messages.append('\n');
+        messages.append(msg);
     }
+    if (!messages.isEmpty())
+        emit sendToSceneMessage(messages);
 
-    for (const auto& msg : m_messageBoxes)
+    for (const auto& msg : m_runResult.messageBoxes)
     {
-        QMessageBox::warning(this, msg.first, msg.second);
+        // a live build must not stop the typing with a modal box
+        if (m_build.isLive)
+            emit sendToSceneMessage(msg.first + ": " + msg.second, ConsoleText::ResultType::Error);
+        else
+            QMessageBox::warning(this, msg.first, msg.second);
     }
 
-    emit finishWork();
+    finishBuild();
 }
 
-void CppCodeBuilder::finishedCompilation(int exitCode, QProcess::ExitStatus exitStatus)
+void CppCodeBuilder::finishedCompilation(int exitCode)
 {
-    emit sendToConsole(tr("Compilation completed."), ConsoleText::ResultType::Complete);
-
-    if (exitStatus == QProcess::ExitStatus::CrashExit) return;
-
-    if (exitCode == 0)
+    if (m_isWarmingUp)
     {
-        m_dll.setFileName(APP.tempDir() + QString("/dllmain"));
-
-        if (!m_dll.load()) {
-            emit sendToConsole(tr("Loading failed!"), ConsoleText::ResultType::Error);
-            return;
-        }
-
-        auto thread = new QThread;
-        auto worker = new Worker(this);
-        worker->moveToThread(thread);
+        // its failures show up again in the next build
+        m_isWarmingUp = false;
+        PROFILER.end("Waiting for warm-up");
+        return;
+    }
+    m_isCompiling = false;
+    endPhase();
 
-        connect(worker, &Worker::error, [this](const QString& msg)
-        {
-            emit sendToConsole(tr("Rendering failed"), ConsoleText::ResultType::Error);
-            emit sendToConsole(msg, ConsoleText::ResultType::Error);
-            releaseDll();
-            emit finishWork();
-        });
+    // the editor marked the errors of a live build already
+    if (m_build.isLive && (exitCode != 0 || isStale()))
+    {
+        finishBuild();
+        return;
+    }
 
-        connect(thread, &QThread::started, worker, &Worker::process);
-        connect(thread, &QThread::finished, worker, &QThread::deleteLater);
-        connect(worker, &Worker::finished, thread, &QThread::deleteLater);
-        connect(worker, &Worker::finished, thread, &QThread::quit);
-        connect(worker, &Worker::finished, this, &CppCodeBuilder::workerFinished);
+    if (!m_build.isLive)
+        emit sendToConsole(tr("Compilation completed."), ConsoleText::ResultType::Complete);
 
-        thread->start();
+    if (exitCode == 0)
+    {
+        QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
+        int timeout = settings.value("Build/RunTimeout", g_kDefaultCodeRunTimeout).toInt() * 1000;
+        if (m_build.isLive)
+            timeout = qBound(1, m_liveBudget - int(m_buildClock.elapsed()), timeout);
+        PROFILER.begin("Run");
+        m_pRunner->run(APP.tempDir() + "/" + m_toolchain->libraryFileName(), timeout);
     }
     else if (exitCode == 1 || exitCode == 2)
     {
@@ -192,30 +460,51 @@ void CppCodeBuilder::finishedCompilation(int exitCode, QProcess::ExitStatus exit
     }
 }
 
-void CppCodeBuilder::prepareErrorsList()
+void CppCodeBuilder::runFailed(const QString& reason)
 {
-    m_errorsList.clear();
-    m_consoleOutput.remove(0, m_consoleOutput.lastIndexOf("\'x64\'"));
-    m_consoleOutput.remove(APP.builderUserFileName());
-
-    QRegularExpression re("\\((\\d+)\\)(.*?)\\n", QRegularExpression::PatternOption::MultilineOption);
-    auto it = re.globalMatch(m_consoleOutput);
-
-    while (it.hasNext())
+    PROFILER.end("Run");
+    if (!m_build.isLive)
     {
-        auto match = it.next();
-        m_errorsList.push_back({ match.captured(1).toInt() , match.captured(2) });
+        emit sendToConsole(tr("Rendering failed"), ConsoleText::ResultType::Error);
+        emit sendToConsole(reason, ConsoleText::ResultType::Error);
     }
+    finishBuild();
+}
+
+void CppCodeBuilder::compilationCrashed()
+{
+    m_isWarmingUp = false;
+    if (!m_isCompiling)
+        return;
+    m_isCompiling = false;
+    endPhase();
+
+    emit sendToConsole(m_consoleOutput, ConsoleText::ResultType::Error);
+    emit sendToConsole(tr("Compilation failed."), ConsoleText::ResultType::Error);
+    finishBuild();
+}
+
+void CppCodeBuilder::endPhase()
+{
+    if (m_phase.isEmpty())
+        return;
+    PROFILER.end(m_phase);
+    m_phase.clear();
+}
 
-    emit signalErrorsList(m_currentTextEdit, m_errorsList);
+void CppCodeBuilder::prepareErrorsList()
+{
+    // the editor got m_errorsList already, line by line in readCompilerLine
+    m_consoleOutput.remove(APP.builderUserFileName());
     emit sendToConsole(m_consoleOutput, ConsoleText::ResultType::Error);
-    emit finishWork();
+    finishBuild();
 }
 
 void CppCodeBuilder::slotMoveToError(const QString& strLine)
 {
-    QRegularExpression re("\\((\\d+)\\)(.*)");
-    auto match = re.match(strLine);
+    if (m_toolchain == nullptr)
+        return;
+    auto match = m_toolchain->diagnosticPattern().match(strLine);
     if (match.hasMatch()) {
         int line = match.captured(1).toInt();
         QString message = match.captured(2);
@@ -1,21 +1,28 @@
 ﻿#pragma once
 
-#include <QLibrary>
+#include <memory>
+#include <optional>
+
 #include <QWidget>
+#include <QElapsedTimer>
 #include <QVector>
 #include <QPair>
 #include <QProcess>
 #include "consoletext.h"
+#include "coderunner.h"
 #include "globaldef.h"
 
+class Toolchain;
+class CompileServer;
+
 class CppCodeBuilder : public QWidget
 {
     Q_OBJECT
 public:
     explicit CppCodeBuilder(QWidget* parent = nullptr);
+    ~CppCodeBuilder() override;
 
     bool compileCode();
-    void releaseDll();
     MbPlacement3D* getPlace();
 
 signals:
@@ -36,27 +43,56 @@ signals:
 
 public slots:
     void receiveCode(const QString& txt, const QString& name);
-    void finishedCompilation(int exitCode, QProcess::ExitStatus exitStatus);
-    void readConsoleOutput();
-    void readConsoleError();
+    // A build for the live preview: quiet, replaced by newer code and shown
+    // only when it succeeds within Build/LivePreviewBudget.
+    void receiveLiveCode(const QString& txt, const QString& name);
+    void finishedCompilation(int exitCode);
+    void compilationCrashed();
+    void readCompilerLine(const QString& line);
     void slotMoveToError(const QString& strLine);
 
 private:
+    struct BuildRequest
+    {
+        QString code;
+        QString editorName;
+        bool isLive = false;
+    };
+
+    void requestBuild(const BuildRequest& request);
+    void startBuild(const BuildRequest& request);
+    void finishBuild();
+    bool isBusy() const;
+    bool isStale() const;
     void prepareErrorsList();
-    void workerFinished(bool res);
+    void runFinished(bool res);
+    void runFailed(const QString& reason);
+    void releaseRunResult();
+    bool updateToolchain();
+    void warmUp();
+    void preparePrecompiledHeader();
+    QByteArray precompiledHeaderHash() const;
+    bool writeBuildScript(const QString& scriptName, const QStringList& sources, bool link);
+    QString cachedObjectName(const QString& sourceName) const;
+    void endPhase();
 
     QString m_consoleOutput;
-    QString m_consoleError;
+    QString m_phase; // of the build script, as its markers tell
 
-    QProcess *consoleProcess;
+    CompileServer* m_pServer;
+    CodeRunner* m_pRunner;
     QString exePath;
+    std::unique_ptr<Toolchain> m_toolchain;
+    QByteArray m_pchHash;
+    bool m_isWarmingUp = false;
+    bool m_isCompiling = false;
 
-    QVector<Model> m_objectsCollection;
-    QVector<QString> m_messages;
-    QVector<QPair<QString, QString>> m_messageBoxes;
+    BuildRequest m_build;                       // the one that runs
+    std::optional<BuildRequest> m_pendingBuild; // starts when it is done
+    QElapsedTimer m_buildClock;
+    int m_liveBudget = g_kDefaultLivePreviewBudget * 1000; // milliseconds, read when a live build starts
+
+    CodeRunResult m_runResult;
     QVector<QPair<int, QString>> m_errorsList;
-    QLibrary m_dll;
     QString m_currentTextEdit;
-
-    friend class Worker;
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+﻿#include <algorithm>
+
+#include <QComboBox>
+#include <QPainter>
+#include <QStyledItemDelegate>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "profilerwidget.h"
+#include "buildprofiler.h"
+
+enum ProfilerRole
+{
+    SpanStartRole = Qt::UserRole,
+    SpanDurationRole,
+    RunDurationRole
+};
+
+enum ProfilerColumn
+{
+    NameColumn,
+    StartColumn,
+    DurationColumn,
+    TimelineColumn
+};
+
+// Draws a span as a bar at its place in the whole run
+class TimelineDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override
+    {
+        QStyledItemDelegate::paint(painter, option, index);
+        const double total = index.data(RunDurationRole).toDouble();
+        if (total <= 0.0)
+            return;
+
+        const QRectF rect = option.rect.adjusted(2, 3, -2, -3);
+        const double start = index.data(SpanStartRole).toDouble() / total;
+        const double duration = index.data(SpanDurationRole).toDouble() / total;
+        const QRectF bar(rect.left() + start * rect.width(), rect.top(), qMax(1.0, duration * rect.width()), rect.height());
+        painter->fillRect(bar, option.palette.highlight());
+    }
+};
+
+static QString milliseconds(qint64 nanoseconds)
+{
+    return QString::number(nanoseconds / 1.0e6, 'f', 1);
+}
+
+ProfilerWidget::ProfilerWidget(QWidget* parent)
+    : QWidget(parent)
+    , m_pRuns(new QComboBox(this))
+    , m_pSpans(new QTreeWidget(this))
+    , m_pRefresh(new QTimer(this))
+{
+    m_pSpans->setColumnCount(4);
+    m_pSpans->setHeaderLabels({ tr("Step"), tr("Start, ms"), tr("Duration, ms"), tr("Timeline") });
+    m_pSpans->setItemDelegateForColumn(TimelineColumn, new TimelineDelegate(m_pSpans));
+    m_pSpans->setRootIsDecorated(true);
+    m_pSpans->setColumnWidth(NameColumn, 220);
+
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_pRuns);
+    layout->addWidget(m_pSpans);
+
+    // the spans of a run come one by one, the panel is redrawn once for a burst of them
+    m_pRefresh->setSingleShot(true);
+    m_pRefresh->setInterval(100);
+    connect(m_pRefresh, &QTimer::timeout, this, &ProfilerWidget::updateRuns);
+    connect(&PROFILER, &BuildProfiler::runStarted, m_pRefresh, QOverload<>::of(&QTimer::start));
+    connect(&PROFILER, &BuildProfiler::runChanged, m_pRefresh, QOverload<>::of(&QTimer::start));
+    connect(m_pRuns, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &ProfilerWidget::showRun);
+
+    updateRuns();
+}
+
+void ProfilerWidget::updateRuns()
+{
+    const QList<ProfileRun>& runs = PROFILER.runs();
+    // a new run is shown, otherwise the one chosen stays
+    const int index = m_pRuns->count() == runs.size() ? m_pRuns->currentIndex() : 0;
+
+    QSignalBlocker blocker(m_pRuns);
+    m_pRuns->clear();
+    for (const ProfileRun& run : runs)
+    {
+        qint64 total = 0;
+        for (const ProfileSpan& span : run.spans)
+            total = qMax(total, span.start + span.duration);
+        m_pRuns->addItem(tr("%1 - %2 ms").arg(run.started.toString("hh:mm:ss")).arg(milliseconds(total)));
+    }
+    m_pRuns->setCurrentIndex(index);
+    showRun(index);
+}
+
+void ProfilerWidget::showRun(int index)
+{
+    m_pSpans->clear();
+    const QList<ProfileRun>& runs = PROFILER.runs();
+    if (index < 0 || index >= runs.size())
+        return;
+
+    const ProfileRun& run = runs[index];
+    // spans are kept in the order they ended, an enclosing one comes last
+    QVector<ProfileSpan> spans = run.spans;
+    std::stable_sort(spans.begin(), spans.end(), [](const ProfileSpan& a, const ProfileSpan& b) { return a.start < b.start; });
+    qint64 total = 0;
+    for (const ProfileSpan& span : spans)
+        total = qMax(total, span.start + span.duration);
+
+    for (const ProfileSpan& span : spans)
+    {
+        auto item = new QTreeWidgetItem(m_pSpans, { span.name, milliseconds(span.start), milliseconds(span.duration) });
+        item->setData(TimelineColumn, SpanStartRole, double(span.start));
+        item->setData(TimelineColumn, SpanDurationRole, double(span.duration));
+        item->setData(TimelineColumn, RunDurationRole, double(total));
+        item->setTextAlignment(StartColumn, Qt::AlignRight);
+        item->setTextAlignment(DurationColumn, Qt::AlignRight);
+    }
+
+    if (!run.kernelTimings.isEmpty())
+    {
+        auto kernel = new QTreeWidgetItem(m_pSpans, { tr("Kernel operations") });
+        for (const KernelTiming& timing : run.kernelTimings)
+        {
+            auto item = new QTreeWidgetItem(kernel, { tr("%1 (%2 calls)").arg(timing.name).arg(timing.count), QString(), QString::number(timing.milliseconds, 'f', 1) });
+            item->setTextAlignment(DurationColumn, Qt::AlignRight);
+        }
+        kernel->setExpanded(true);
+    }
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include <QWidget>
+
+class QComboBox;
+class QTreeWidget;
+class QTimer;
+
+// Panel with the timeline of a run of the code builder; the combo box goes
+// back through the runs BuildProfiler keeps.
+class ProfilerWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ProfilerWidget(QWidget* parent = nullptr);
+
+private:
+    void updateRuns();
+    void showRun(int index);
+
+    QComboBox* m_pRuns;
+    QTreeWidget* m_pSpans;
+    QTimer* m_pRefresh;
+};
@@ -0,0 +1,420 @@
+﻿#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+
+#include "toolchain.h"
+#include "storagelocation.h"
+#include "globaldef.h"
+
+static QString quoted(const QString& text)
+{
+    return QString("\"%1\"").arg(text);
+}
+
+static QString pchHeaderName()
+{
+    return APP.tempDir() + "/" + g_kDefaultBuilderPchHeaderFileName;
+}
+
+/* Toolchain */
+Toolchain::Toolchain(const QString& compilerPath)
+    : m_compilerPath(compilerPath)
+{
+}
+
+std::unique_ptr<Toolchain> Toolchain::create(const QString& compilerPath)
+{
+    if (QFileInfo(compilerPath).suffix().compare("bat", Qt::CaseInsensitive) == 0)
+        return std::make_unique<MsvcToolchain>(compilerPath);
+    return std::make_unique<GccToolchain>(compilerPath);
+}
+
+//-----------------------------------------------------------------------------
+// vswhere lists every Visual Studio with the C++ tools, the fixed install
+// paths catch the ones it does not know. On other systems the drivers are
+// looked up in PATH.
+// ---
+QStringList Toolchain::findCompilers()
+{
+    QStringList compilers;
+#ifdef Q_OS_WIN
+    const QString vswhere = qEnvironmentVariable("ProgramFiles(x86)") + "/Microsoft Visual Studio/Installer/vswhere.exe";
+    if (QFileInfo::exists(vswhere))
+    {
+        QProcess process;
+        process.start(vswhere, { "-products", "*", "-requires", "Microsoft.VisualStudio.Component.VC.Tools.x86.x64", "-property", "installationPath" });
+        if (process.waitForFinished(5000))
+        {
+            const QStringList paths = QString::fromLocal8Bit(process.readAllStandardOutput()).split('\n', QString::SkipEmptyParts);
+            for (const QString& path : paths)
+                compilers << QDir::fromNativeSeparators(path.trimmed()) + "/VC/Auxiliary/Build/vcvars64.bat";
+        }
+    }
+    for (const QString& year : { "2019", "2017" })
+    {
+        for (const QString& type : { "Community", "Professional", "Enterprise", "BuildTools" })
+            compilers << g_kVariableMSVCPath.arg(year).arg(type);
+    }
+    compilers.removeDuplicates();
+    for (int i = compilers.size() - 1; i >= 0; --i)
+    {
+        if (!QFileInfo::exists(compilers[i]))
+            compilers.removeAt(i);
+    }
+#else
+    for (const QString& name : { "g++", "clang++", "c++" })
+    {
+        const QString path = QStandardPaths::findExecutable(name);
+        if (!path.isEmpty())
+            compilers << path;
+    }
+#endif
+    return compilers;
+}
+
+QString Toolchain::defaultCompilerPath()
+{
+#ifdef Q_OS_WIN
+    return findCompilers().value(0, g_kDefaultMSVCPath);
+#else
+    return findCompilers().value(0, "g++");
+#endif
+}
+
+bool Toolchain::isCompilerPath(const QString& path)
+{
+    const QFileInfo info(path);
+#ifdef Q_OS_WIN
+    return info.fileName().compare("vcvars64.bat", Qt::CaseInsensitive) == 0;
+#else
+    return info.isFile() && info.isExecutable();
+#endif
+}
+
+QString Toolchain::compilerPath() const
+{
+    return m_compilerPath;
+}
+
+bool Toolchain::isObjectCurrent(const QString& /*objectName*/) const
+{
+    return true;
+}
+
+/* MsvcToolchain */
+MsvcToolchain::MsvcToolchain(const QString& compilerPath)
+    : Toolchain(compilerPath)
+{
+}
+
+QString MsvcToolchain::flags() const
+{
+    QString flags("/UTF-8 /nologo /TP -DUNICODE -D_UNICODE /DWIN32 /D_WINDOWS /GR /EHsc ");
+#ifdef _DEBUG
+    flags += QString("/Zi /Ob0 /Od /RTC1 /W4 /D_DEBUG /D_DRAWGI /MP /bigobj -MDd -std:c++14 ");
+#else
+    flags += QString("/O2 /Ob2 -DNDEBUG /W4 /MD -std:c++14 ");
+#endif // DEBUG
+    return flags;
+}
+
+QString MsvcToolchain::scriptFileName() const
+{
+    return g_kDefaultBuilderInitFileName;
+}
+
+QString MsvcToolchain::shellProgram() const
+{
+    return QString("cmd.exe");
+}
+
+QStringList MsvcToolchain::shellArguments() const
+{
+    // no echo of the prompt and of the commands written to it
+    return { "/Q" };
+}
+
+//-----------------------------------------------------------------------------
+// vcvars64.bat alone takes a second or two; it runs once per shell.
+// ---
+QStringList MsvcToolchain::environmentCommands() const
+{
+    return { QString("chcp 65001 > nul"),
+             QString("call \"%1\" > nul").arg(QDir::toNativeSeparators(m_compilerPath)),
+             QString("cd /d \"%1\"").arg(QDir::toNativeSeparators(APP.tempDir())) };
+}
+
+QString MsvcToolchain::readyCommand(const QString& marker) const
+{
+    return QString("echo %1 0").arg(marker);
+}
+
+QStringList MsvcToolchain::runCommands(const QString& scriptName, const QString& marker) const
+{
+    return { QString("call \"%1\"").arg(QDir::toNativeSeparators(scriptName)),
+             QString("echo %1 %errorlevel%").arg(marker) };
+}
+
+QString MsvcToolchain::objectFileName(const QString& baseName) const
+{
+    return baseName + ".obj";
+}
+
+QString MsvcToolchain::libraryFileName() const
+{
+    return QString("dllmain.dll");
+}
+
+QStringList MsvcToolchain::precompiledHeaderFiles() const
+{
+    return { APP.tempDir() + "/" + g_kDefaultBuilderPchFileName,
+             APP.tempDir() + "/" + objectFileName(QFileInfo(g_kDefaultBuilderPchSourceFileName).completeBaseName()) };
+}
+
+void MsvcToolchain::writePrologue(QTextStream& script) const
+{
+    // the environment is already set up, see environmentCommands
+    script << QString("@echo off\r\n");
+    script << QString("cd /d \"%1\"\r\n").arg(APP.tempDir());
+}
+
+void MsvcToolchain::writePrecompile(QTextStream& script) const
+{
+    script << QString("@if not exist \"%1\\%5\" cl %2/Fo\"%1\"\\ -c /I \"%3\" /I \"%4\" /I \"%1\" /Yc\"%6\" /Fp\"%1\\%5\" \"%1\\%7\" || exit /b 2\r\n")
+    /*%1*/.arg(APP.tempDir())
+    /*%2*/.arg(flags())
+    /*%3*/.arg(APP.kernelDir())
+    /*%4*/.arg(APP.userDir())
+    /*%5*/.arg(g_kDefaultBuilderPchFileName)
+    /*%6*/.arg(g_kDefaultBuilderPchHeaderFileName)
+    /*%7*/.arg(g_kDefaultBuilderPchSourceFileName);
+}
+
+//-----------------------------------------------------------------------------
+// One cl per source: /Fo names a single object only. /MP of the debug flags
+// still spreads the work of each over the cores.
+// ---
+void MsvcToolchain::writeCompile(QTextStream& script, const QVector<CompileJob>& jobs) const
+{
+    for (const CompileJob& job : jobs)
+    {
+        script << QString("cl %1/Fo\"%2\" -c /I \"%3\" /I \"%4\" /I \"%5\" /FI\"%6\" /Yu\"%6\" /Fp\"%5\\%7\" \"%8\" || exit /b 2\r\n")
+        /*%1*/.arg(flags())
+        /*%2*/.arg(QDir::toNativeSeparators(job.object))
+        /*%3*/.arg(APP.kernelDir())
+        /*%4*/.arg(APP.userDir())
+        /*%5*/.arg(APP.tempDir())
+        /*%6*/.arg(g_kDefaultBuilderPchHeaderFileName)
+        /*%7*/.arg(g_kDefaultBuilderPchFileName)
+        /*%8*/.arg(job.source);
+    }
+}
+
+void MsvcToolchain::writeLink(QTextStream& script, const QStringList& objects) const
+{
+    QStringList linked(QDir::toNativeSeparators(precompiledHeaderFiles().last()));
+    for (const QString& object : objects)
+        linked << QDir::toNativeSeparators(object);
+
+    script << QString("link \"%1\" /out:\"%2\\%3\" /dll /machine:x64 /INCREMENTAL:NO \"%4\" || exit /b 3\r\n")
+    /*%1*/.arg(linked.join("\" \""))
+    /*%2*/.arg(APP.tempDir())
+    /*%3*/.arg(libraryFileName())
+    /*%4*/.arg(APP.userDir() + "/c3d.lib");
+}
+
+void MsvcToolchain::writePhase(QTextStream& script, const QString& name) const
+{
+    script << QString("echo %1%2\r\n").arg(g_kDefaultBuilderPhaseMarker, name);
+}
+
+QRegularExpression MsvcToolchain::diagnosticPattern() const
+{
+    return QRegularExpression("\\((\\d+)\\)(.*)");
+}
+
+/* GccToolchain */
+GccToolchain::GccToolchain(const QString& compilerPath)
+    : Toolchain(compilerPath)
+{
+}
+
+bool GccToolchain::isClang() const
+{
+    return QFileInfo(m_compilerPath).fileName().contains("clang");
+}
+
+QString GccToolchain::flags() const
+{
+    QString flags("-std=c++14 -fPIC -Wall ");
+#ifdef _DEBUG
+    flags += QString("-g -O0 -D_DEBUG ");
+#else
+    flags += QString("-O2 -DNDEBUG ");
+#endif // DEBUG
+    return flags;
+}
+
+QString GccToolchain::includeFlags() const
+{
+    return QString("-I %1 -I %2 -I %3 ").arg(quoted(APP.kernelDir())).arg(quoted(APP.userDir())).arg(quoted(APP.tempDir()));
+}
+
+QString GccToolchain::scriptFileName() const
+{
+    return g_kDefaultBuilderInitShellFileName;
+}
+
+QString GccToolchain::shellProgram() const
+{
+    return QString("/bin/sh");
+}
+
+QStringList GccToolchain::shellArguments() const
+{
+    return {};
+}
+
+QStringList GccToolchain::environmentCommands() const
+{
+    return { QString("exec 2>&1"), QString("cd %1").arg(quoted(APP.tempDir())) };
+}
+
+QString GccToolchain::readyCommand(const QString& marker) const
+{
+    // quoted, the marker starts with # and would be a comment
+    return QString("echo \"%1 0\"").arg(marker);
+}
+
+QStringList GccToolchain::runCommands(const QString& scriptName, const QString& marker) const
+{
+    return { QString("/bin/sh %1").arg(quoted(scriptName)),
+             QString("echo \"%1 $?\"").arg(marker) };
+}
+
+QString GccToolchain::objectFileName(const QString& baseName) const
+{
+    return baseName + ".o";
+}
+
+QString GccToolchain::libraryFileName() const
+{
+    return QString("libdllmain.so");
+}
+
+//-----------------------------------------------------------------------------
+// Both drivers pick the header up by -include when it lies next to pch.h.
+// ---
+QStringList GccToolchain::precompiledHeaderFiles() const
+{
+    return { pchHeaderName() + (isClang() ? ".pch" : ".gch") };
+}
+
+void GccToolchain::writePrologue(QTextStream& script) const
+{
+    // diagnostics are parsed from one stream
+    script << QString("exec 2>&1\n");
+    script << QString("cd %1 || exit 2\n").arg(quoted(APP.tempDir()));
+}
+
+void GccToolchain::writePrecompile(QTextStream& script) const
+{
+    const QString pchName = precompiledHeaderFiles().first();
+    script << QString("[ -f %1 ] || %2 %3%4-x c++-header %5 -o %1 || exit 2\n")
+    /*%1*/.arg(quoted(pchName))
+    /*%2*/.arg(quoted(m_compilerPath))
+    /*%3*/.arg(flags())
+    /*%4*/.arg(includeFlags())
+    /*%5*/.arg(quoted(pchHeaderName()));
+}
+
+//-----------------------------------------------------------------------------
+// The sources are compiled as background jobs, as many at a time as there
+// are cores; a failed job fails the script once all of them finished.
+// ---
+void GccToolchain::writeCompile(QTextStream& script, const QVector<CompileJob>& jobs) const
+{
+    if (jobs.isEmpty())
+        return;
+
+    const int jobsCount = qMax(1, QThread::idealThreadCount());
+    script << QString("failed=0\n");
+    for (int first = 0; first < jobs.size(); first += jobsCount)
+    {
+        const int last = qMin(first + jobsCount, jobs.size());
+        for (int i = first; i < last; ++i)
+        {
+            const CompileJob& job = jobs[i];
+            script << QString("%1 %2%3-include %4 -MMD -MF %5 -c %6 -o %7 &\njob%8=$!\n")
+            /*%1*/.arg(quoted(m_compilerPath))
+            /*%2*/.arg(flags())
+            /*%3*/.arg(includeFlags())
+            /*%4*/.arg(quoted(pchHeaderName()))
+            /*%5*/.arg(quoted(job.object + ".d"))
+            /*%6*/.arg(quoted(job.source))
+            /*%7*/.arg(quoted(job.object))
+            /*%8*/.arg(i);
+        }
+        for (int i = first; i < last; ++i)
+            script << QString("wait $job%1 || failed=1\n").arg(i);
+    }
+    script << QString("[ $failed -eq 0 ] || exit 2\n");
+}
+
+//-----------------------------------------------------------------------------
+// The kernel symbols are left undefined; they resolve against the kernel
+// library C3DCodeHost has already loaded.
+// ---
+void GccToolchain::writeLink(QTextStream& script, const QStringList& objects) const
+{
+    QStringList linked;
+    for (const QString& object : objects)
+        linked << quoted(object);
+
+    script << QString("%1 -shared -o %2 %3 || exit 3\n")
+    /*%1*/.arg(quoted(m_compilerPath))
+    /*%2*/.arg(quoted(APP.tempDir() + "/" + libraryFileName()))
+    /*%3*/.arg(linked.join(' '));
+}
+
+void GccToolchain::writePhase(QTextStream& script, const QString& name) const
+{
+    // quoted, a word starting with # would be a comment
+    script << QString("echo %1\n").arg(quoted(g_kDefaultBuilderPhaseMarker + name));
+}
+
+//-----------------------------------------------------------------------------
+// Reads the dependency file -MMD wrote next to the object; an object without
+// one is built again.
+// ---
+bool GccToolchain::isObjectCurrent(const QString& objectName) const
+{
+    QFile dependencies(objectName + ".d");
+    if (!dependencies.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QString text = QString::fromLocal8Bit(dependencies.readAll());
+    text.remove(0, text.indexOf(": ") + 1);
+    text.replace("\\\n", " ");
+    text.replace("\\ ", QChar(0x1f)); // escaped spaces inside a path
+
+    const QDateTime built = QFileInfo(objectName).lastModified();
+    const QStringList headers = text.split(QRegularExpression("\\s+"), QString::SkipEmptyParts);
+    for (QString header : headers)
+    {
+        const QFileInfo info(header.replace(QChar(0x1f), ' '));
+        if (!info.exists() || info.lastModified() > built)
+            return false;
+    }
+    return true;
+}
+
+QRegularExpression GccToolchain::diagnosticPattern() const
+{
+    return QRegularExpression("^[^:\\n]*:(\\d+):(?:\\d+:)?(.*)$", QRegularExpression::MultilineOption);
+}
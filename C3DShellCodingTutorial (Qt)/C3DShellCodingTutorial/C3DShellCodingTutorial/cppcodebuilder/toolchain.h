@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QRegularExpression>
+
+class QTextStream;
+
+// One source of the user code and the object it is compiled to
+struct CompileJob
+{
+    QString source;
+    QString object;
+};
+
+// Compiler the user code is built with. A backend writes the commands of the
+// build script that CompileServer runs in the resident shell of the platform.
+// The script exits with 2 when a source does not compile; any other failure
+// is reported as a link error.
+class Toolchain
+{
+public:
+    virtual ~Toolchain() = default;
+
+    // vcvars64.bat selects MSVC, any other path a GCC or Clang driver.
+    static std::unique_ptr<Toolchain> create(const QString& compilerPath);
+    // Compilers installed on this machine, the preferred one first.
+    static QStringList findCompilers();
+    static QString defaultCompilerPath();
+    static bool isCompilerPath(const QString& path);
+
+    QString compilerPath() const;
+    virtual QString flags() const = 0;
+
+    virtual QString scriptFileName() const = 0;
+    virtual QString shellProgram() const = 0;
+    // The shell reads its commands from the standard input.
+    virtual QStringList shellArguments() const = 0;
+    // Sent once when the shell starts; every build script runs in this environment.
+    virtual QStringList environmentCommands() const = 0;
+    // Prints the marker followed by 0 once the environment commands are done.
+    virtual QString readyCommand(const QString& marker) const = 0;
+    // Runs the script, then prints the marker followed by the exit code of the script.
+    virtual QStringList runCommands(const QString& scriptName, const QString& marker) const = 0;
+
+    virtual QString objectFileName(const QString& baseName) const = 0;
+    virtual QString libraryFileName() const = 0;
+    // Files made by writePrecompile, deleted when the header gets stale
+    virtual QStringList precompiledHeaderFiles() const = 0;
+
+    virtual void writePrologue(QTextStream& script) const = 0;
+    virtual void writePrecompile(QTextStream& script) const = 0;
+    virtual void writeCompile(QTextStream& script, const QVector<CompileJob>& jobs) const = 0;
+    virtual void writeLink(QTextStream& script, const QStringList& objects) const = 0;
+    // Prints g_kDefaultBuilderPhaseMarker and the name when the script gets there.
+    virtual void writePhase(QTextStream& script, const QString& name) const = 0;
+
+    // False when a header the object was built from changed since.
+    virtual bool isObjectCurrent(const QString& objectName) const;
+    // Captures the line and the message of one line of the compiler output.
+    virtual QRegularExpression diagnosticPattern() const = 0;
+
+protected:
+    explicit Toolchain(const QString& compilerPath);
+
+    QString m_compilerPath;
+};
+
+// cl and link run from a batch file in a cmd.exe that called vcvars64.bat
+class MsvcToolchain : public Toolchain
+{
+public:
+    explicit MsvcToolchain(const QString& compilerPath);
+
+    QString flags() const override;
+    QString scriptFileName() const override;
+    QString shellProgram() const override;
+    QStringList shellArguments() const override;
+    QStringList environmentCommands() const override;
+    QString readyCommand(const QString& marker) const override;
+    QStringList runCommands(const QString& scriptName, const QString& marker) const override;
+    QString objectFileName(const QString& baseName) const override;
+    QString libraryFileName() const override;
+    QStringList precompiledHeaderFiles() const override;
+    void writePrologue(QTextStream& script) const override;
+    void writePrecompile(QTextStream& script) const override;
+    void writeCompile(QTextStream& script, const QVector<CompileJob>& jobs) const override;
+    void writeLink(QTextStream& script, const QStringList& objects) const override;
+    void writePhase(QTextStream& script, const QString& name) const override;
+    QRegularExpression diagnosticPattern() const override;
+};
+
+// g++ or clang++ run from a shell script, building a shared object
+class GccToolchain : public Toolchain
+{
+public:
+    explicit GccToolchain(const QString& compilerPath);
+
+    QString flags() const override;
+    QString scriptFileName() const override;
+    QString shellProgram() const override;
+    QStringList shellArguments() const override;
+    QStringList environmentCommands() const override;
+    QString readyCommand(const QString& marker) const override;
+    QStringList runCommands(const QString& scriptName, const QString& marker) const override;
+    QString objectFileName(const QString& baseName) const override;
+    QString libraryFileName() const override;
+    QStringList precompiledHeaderFiles() const override;
+    void writePrologue(QTextStream& script) const override;
+    void writePrecompile(QTextStream& script) const override;
+    void writeCompile(QTextStream& script, const QVector<CompileJob>& jobs) const override;
+    void writeLink(QTextStream& script, const QStringList& objects) const override;
+    void writePhase(QTextStream& script, const QString& name) const override;
+    bool isObjectCurrent(const QString& objectName) const override;
+    QRegularExpression diagnosticPattern() const override;
+
+private:
+    bool isClang() const;
+    QString includeFlags() const;
+};
@@ -6,6 +6,7 @@
 #include <QAction>
 
 #include <model_item.h>
+#include <tool_multithreading.h>
 
 enum class Menus
 {
@@ -39,6 +40,7 @@ enum class Actions
     kManuals,
     KSceneCon,
     KMessageCon,
+    KProfilerCon,
     KBackTuGallery,
 
     kWebHistoryBack,
@@ -94,6 +96,14 @@ enum class Mode
 };
 
 inline constexpr int g_kIconSize = 18;
+inline constexpr int g_kDefaultCodeRunTimeout = 30; // seconds
+inline constexpr int g_kDefaultProfilerHistorySize = 20; // runs
+inline constexpr int g_kDefaultConsoleLineLimit = 20000;
+// the scene is built on worker threads, which needs at least mtm_SafeItems
+inline constexpr MbeMultithreadedMode g_kDefaultMultithreadedMode = mtm_Items;
+inline constexpr int g_kDefaultLivePreviewDelay = 800; // milliseconds of no typing
+inline constexpr int g_kDefaultLivePreviewBudget = 10; // seconds to build and run
+inline constexpr qint64 g_kDefaultMeshCacheSizeLimit = 1024ll * 1024 * 1024; // bytes on disk
 inline const QString g_kDefaultCommonName(QStringLiteral("C3DShellCodingTutorial"));
 inline const QString g_kDefaultWorkDirectoryName(QStringLiteral("WorkFolder"));
 inline const QString g_kDefaultTutorialsDirectoryName(QStringLiteral("Tutorials"));
@@ -101,9 +111,19 @@ inline const QString g_kDefaultBuilderDirectoryName(QStringLiteral("User"));
 inline const QString g_kDefaultKernelDirectoryName(QStringLiteral("User/Kernel"));
 inline const QString g_kDefaultManualsDirectoryName(QStringLiteral("Manuals"));
 inline const QString g_kDefaultModelsDirectoryName(QStringLiteral("Models"));
+inline const QString g_kDefaultMeshCacheDirectoryName(QStringLiteral("MeshCache"));
+inline const QString g_kDefaultObjectCacheDirectoryName(QStringLiteral("ObjectCache"));
 inline const QString g_kDefaultBuilderUserFileName(QStringLiteral("code.cpp"));
 inline const QString g_kDefaultBuilderUserMainFileName(QStringLiteral("dllmain.cpp"));
 inline const QString g_kDefaultBuilderInitFileName(QStringLiteral("initc.bat"));
+inline const QString g_kDefaultBuilderInitShellFileName(QStringLiteral("initc.sh"));
+inline const QString g_kDefaultBuilderWarmUpPrefix(QStringLiteral("warmup_"));
+inline const QString g_kDefaultBuilderPhaseMarker(QStringLiteral("#c3d-phase "));
+inline const QString g_kDefaultBuilderPchHeaderFileName(QStringLiteral("pch.h"));
+inline const QString g_kDefaultBuilderPchSourceFileName(QStringLiteral("pch.cpp"));
+inline const QString g_kDefaultBuilderPchFileName(QStringLiteral("c3d.pch"));
+inline const QString g_kDefaultCodeHostFileName(QStringLiteral("C3DCodeHost"));
+inline const QString g_kDefaultHeaderIndexFileName(QStringLiteral("headers.idx"));
 inline const QString g_kDefaultWebDocRoot(QStringLiteral("https://c3d.ascon.%1/doc/math"));
 inline const QString g_kDefaultLocalDocRoot(QStringLiteral("Docs/%1"));
 inline const QString g_kDefaultEn(QStringLiteral("net"));
@@ -8,10 +8,11 @@
 #include <vsn_application.h>
 
 #include "mainwindow.h"
+#include "globaldef.h"
 
 int main(int argc, char** argv)
 {
-    Math::SetMultithreadedMode(mtm_Off);
+    Math::SetMultithreadedMode(g_kDefaultMultithreadedMode);
 
     QCoreApplication::setApplicationName("C3DShellCodingTutorial");
     QCoreApplication::setOrganizationName("Moscow Polytech");
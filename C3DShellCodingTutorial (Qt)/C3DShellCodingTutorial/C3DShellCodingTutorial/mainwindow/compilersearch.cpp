@@ -9,6 +9,7 @@
 #include "ui_compilersearch.h"
 #include "compilersearch.h"
 #include "storagelocation.h"
+#include "toolchain.h"
 #include "globaldef.h"
 
 //-----------------------------------------------------------------------------
@@ -17,7 +18,7 @@
 CompilerSearch::CompilerSearch(QWidget* parent)
     : QWidget(parent)
     , ui(new Ui::CompilerSearch)
-    , m_path(g_kDefaultMSVCPath)
+    , m_path(Toolchain::defaultCompilerPath())
     , m_type("Community")
     , m_year("2019")
 {
@@ -85,7 +86,7 @@ CompilerSearch::CompilerSearch(QWidget* parent)
             ui->pushButtonOpen->setDisabled(true);
 
             lastChoice = 0;
-            m_path = g_kDefaultMSVCPath;
+            m_path = Toolchain::defaultCompilerPath();
             ui->labelPath->setText(m_path);
         }
     });
@@ -117,16 +118,21 @@ CompilerSearch::CompilerSearch(QWidget* parent)
 
     connect(ui->pushButtonOpen, &QRadioButton::clicked, [this](bool checked)
     {
+#ifdef Q_OS_WIN
         auto fileName = QFileDialog::getOpenFileName(this, tr("Path to vcvars64.bat"),
-            QString("C:/Program Files (x86)/Microsoft Visual Studio/)_"), tr("*.bat"));
-        if (fileName.isEmpty()) { return false; }
+            QString("C:/Program Files (x86)/Microsoft Visual Studio/"), tr("*.bat"));
+#else
+        auto fileName = QFileDialog::getOpenFileName(this, tr("Path to g++ or clang++"), QString("/usr/bin"));
+#endif
+        if (fileName.isEmpty()) { return; }
+        m_path = fileName;
         ui->labelPath->setText(fileName);
     });
 
 
     connect(ui->pushButtonAccept, &QPushButton::clicked, [this]()
     {
-        if (QFileInfo(m_path).fileName() == "vcvars64.bat")
+        if (Toolchain::isCompilerPath(m_path))
         {
             APP.saveCommonSettings("Build/CompilerPath", m_path);
         }
@@ -26,6 +26,7 @@
 #include "mainwindow.h"
 #include "cppcodebuilder.h"
 #include "consoletext.h"
+#include "profilerwidget.h"
 #include "dockwidget.h"
 
 #include "welcomewidget.h"
@@ -215,6 +216,7 @@ void MainWindow::commonSetup()
     auto consoleArea = buildBuilderConsoleDock(ads::BottomDockWidgetArea);
 
     buildSceneConsoleDock(ads::CenterDockWidgetArea, consoleArea);
+    buildProfilerDock(ads::CenterDockWidgetArea, consoleArea);
 
     auto mainArea = buildDocumentationDock(ads::TopDockWidgetArea);
 
@@ -870,12 +872,7 @@ void MainWindow::connectScene()
 
     connect(m_actions[Actions::kSceneZoomToFit], &QAction::triggered, [this]()
     {
-        if (m_pScene->ObjectsSegment->GetBoundingBox().IsEmpty()) 
-            m_pScene->viewport()->ZoomToFit(m_pScene->sceneContent()->GetBoundingBox());
-        else 
-            m_pScene->viewport()->ZoomToFit(m_pScene->ObjectsSegment->GetBoundingBox());
-
-        m_pScene->update();
+        m_pScene->zoomToFit();
     });
 
     // Send Message
@@ -891,6 +888,13 @@ void MainWindow::connectScene()
         m_pConsoleSceneMessage->addText(txt, color);
     });
     connect(m_pScene.get(), &VisionScene::clearConsole, m_pConsoleSceneMessage, &ConsoleText::clear);
+    connect(m_pScene.get(), &VisionScene::buildProgress, [this](int value, int maximum)
+    {
+        if (value < maximum)
+            statusBar()->showMessage(tr("Building geometry %1 of %2").arg(value).arg(maximum));
+        else
+            statusBar()->showMessage(tr("Ready"));
+    });
 }
 //-----------------------------------------------------------------------------
 // 
@@ -1233,6 +1237,35 @@ ads::CDockAreaWidget* MainWindow::buildSceneConsoleDock(ads::DockWidgetArea plac
 //-----------------------------------------------------------------------------
 // 
 // ---
+ads::CDockAreaWidget* MainWindow::buildProfilerDock(ads::DockWidgetArea place, ads::CDockAreaWidget* area)
+{
+    m_pDockProfiler = new ads::CDockWidget("Profiler");
+    auto newArea = m_pDockManager->addDockWidget(place, m_pDockProfiler, area);
+
+    auto icon = svgIcon(QStringLiteral(":/res/icons/console.svg"));
+    m_pDockProfiler->setIcon(icon);
+    m_actions[Actions::KProfilerCon] = m_pDockProfiler->toggleViewAction();
+    m_actions[Actions::KProfilerCon]->setIcon(icon);
+    m_actions[Actions::KProfilerCon]->setText(tr("Profiler"));
+    m_toolBars[ToolBars::kView]->addAction(m_actions[Actions::KProfilerCon]);
+
+    // the runs are recorded while the panel is closed, it shows them when opened
+    connect(m_pDockProfiler, &ads::CDockWidget::visibilityChanged, [this](bool visible)
+    {
+        if (visible == true && m_pProfiler == nullptr)
+        {
+            m_pProfiler = new ProfilerWidget();
+            m_pDockProfiler->setWidget(m_pProfiler);
+            m_pDockProfiler->setWindowTitle(tr("Profiler"));
+        }
+    });
+
+    m_pDockProfiler->toggleView(false);
+    return newArea;
+}
+//-----------------------------------------------------------------------------
+// 
+// ---
 void MainWindow::createPdfListToolBar()
 {
 }
@@ -1415,6 +1448,7 @@ void MainWindow::connectActions()
 
 
     connect(m_pTextEditManager, &TextEditManager::sendCode, m_pCodeBuilder.get(), &CppCodeBuilder::receiveCode);
+    connect(m_pTextEditManager, &TextEditManager::sendLiveCode, m_pCodeBuilder.get(), &CppCodeBuilder::receiveLiveCode);
 
 }
 //-----------------------------------------------------------------------------
@@ -34,6 +34,7 @@ class CppCodeBuilder;
 class WelcomeWidget;
 class TextEditManager;
 class ConsoleText;
+class ProfilerWidget;
 class TutorialGalleryWidget;
 class DocumentationWidget;
 class TutorialWidget;
@@ -101,6 +102,9 @@ private:
     void connectSceneConsole();
     ads::CDockAreaWidget* buildSceneConsoleDock(ads::DockWidgetArea place,
         ads::CDockAreaWidget* area = nullptr);
+    // Profiler
+    ads::CDockAreaWidget* buildProfilerDock(ads::DockWidgetArea place,
+        ads::CDockAreaWidget* area = nullptr);
     // PdfList
     void createPdfListToolBar();
     void connectPdfList();
@@ -145,6 +149,7 @@ private:
     ads::CDockWidget* m_pDockScene = nullptr;
     ads::CDockWidget* m_pDockConsoleCodeBuilder = nullptr;
     ads::CDockWidget* m_pDockConsoleSceneMessage = nullptr;
+    ads::CDockWidget* m_pDockProfiler = nullptr;
     ads::CDockWidget* m_pDockGallery = nullptr;
     ads::CDockWidget* m_pDockPdfList = nullptr;
     ads::CDockWidget* m_pDockDocumentation = nullptr;
@@ -155,6 +160,7 @@ private:
     TutorialGalleryWidget* m_pGallery = nullptr;
     ConsoleText* m_pConsoleCodeBuilder = nullptr;
     ConsoleText* m_pConsoleSceneMessage = nullptr;
+    ProfilerWidget* m_pProfiler = nullptr;
     PdfListWidget* m_pPdfListWidget = nullptr;
     DocumentationWidget* m_pDocumentation = nullptr;
     TutorialWidget* m_pTutorial = nullptr;
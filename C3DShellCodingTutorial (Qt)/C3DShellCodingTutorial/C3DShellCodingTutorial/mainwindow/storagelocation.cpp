@@ -62,10 +62,24 @@ StorageLocation::StorageLocation(const QString& appPath)
         userDir_.mkpath(".");
     }
 
+    // dllmain.cpp and resultblock.h make the interface C3DCodeHost loads, an
+    // older copy of them is replaced
+    const QStringList hostInterface = { g_kDefaultBuilderUserMainFileName, QStringLiteral("resultblock.h") };
     QDirIterator itUserDir(":/res/texts/user", QDirIterator::Subdirectories);
     while (itUserDir.hasNext()) {
         auto srcFileName = itUserDir.next();
         QString dstFileName = QString("%1/%2").arg(userDir()).arg(QFileInfo(srcFileName).fileName());
+        if (QFile::exists(dstFileName) && hostInterface.contains(QFileInfo(srcFileName).fileName()))
+        {
+            QFile src(srcFileName);
+            QFile dst(dstFileName);
+            if (src.open(QIODevice::ReadOnly) && dst.open(QIODevice::ReadOnly) && src.readAll() != dst.readAll())
+            {
+                dst.close();
+                dst.setPermissions(QFile::ReadOther | QFile::WriteOther);
+                dst.remove();
+            }
+        }
         if (!QFile::exists(dstFileName))
             QFile::copy(srcFileName, dstFileName);
     }
@@ -153,6 +167,16 @@ QString StorageLocation::modelsDir() const
     return m_appPath + "/" + g_kDefaultModelsDirectoryName;
 }
 
+QString StorageLocation::meshCacheDir() const
+{
+    return QString("%1/%2").arg(tempDir()).arg(g_kDefaultMeshCacheDirectoryName);
+}
+
+QString StorageLocation::objectCacheDir() const
+{
+    return QString("%1/%2").arg(tempDir()).arg(g_kDefaultObjectCacheDirectoryName);
+}
+
 QString StorageLocation::builderUserFileBaseName() const
 {
     return g_kDefaultBuilderUserFileName;
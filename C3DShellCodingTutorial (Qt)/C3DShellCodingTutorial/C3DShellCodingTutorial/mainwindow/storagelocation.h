@@ -22,6 +22,8 @@ public:
     QString kernelDir() const;
     QString manualsDir() const;
     QString modelsDir() const;
+    QString meshCacheDir() const;
+    QString objectCacheDir() const;
     QString builderUserFileBaseName() const;
     QString builderUserFileName() const;
     QString webDocRoot() const;
@@ -1,4 +1,11 @@
 ﻿#include "setup.h"
+#include "resultblock.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <thread>
 
 #include <model_item.h>
 #include <reference_item.h>
@@ -12,9 +19,16 @@
 #include <curve3d.h>
 #include <surface.h>
 #include <space_instance.h>
+#include <tool_mutex.h>
+#include <tool_multithreading.h>
 
+#ifdef _WIN32
 #define CALL_DECLARATION __cdecl
 #define FUNC(retType) __declspec( dllexport ) retType CALL_DECLARATION
+#else
+#define CALL_DECLARATION
+#define FUNC(retType) __attribute__(( visibility("default") )) retType CALL_DECLARATION
+#endif
 
 std::vector<Model> models;
 std::vector<std::string> messages;
@@ -181,6 +195,76 @@ void show(const Style& style, const MbCartPoint& cartPoint, const MbPlacement3D*
 
 
 
+//------------------------------------------------------------------------------
+// The threads take the next index as they get free, each result has its own
+// slot, so nothing is locked. show() runs afterwards on the calling thread.
+// ---
+void parallel_show(const Style& style, size_t count, const std::function<MbSpaceItem*(size_t index)>& build)
+{
+    std::vector<MbSpaceItem*> items(count, nullptr);
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::atomic_flag hasError = ATOMIC_FLAG_INIT;
+
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                items[i] = build(i);
+            }
+            catch (...)
+            {
+                if (!hasError.test_and_set())
+                    error = std::current_exception();
+            }
+        }
+    };
+
+    size_t threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0 || threadCount > count)
+        threadCount = count;
+    const MbeMultithreadedMode mode = Math::MultithreadedMode();
+    // the kernel keeps its caches per thread in this mode
+    if (threadCount > 1 && mode < mtm_Items)
+        Math::SetMultithreadedMode(mtm_Items);
+    {
+        ParallelRegionGuard parallelRegion;
+        std::vector<std::thread> threads;
+        try
+        {
+            for (size_t i = 1; i < threadCount; ++i)
+                threads.emplace_back(work);
+        }
+        catch (...)
+        {
+            // no more threads to be had; the ones running share the rest
+        }
+        work();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+    if (Math::MultithreadedMode() != mode)
+    {
+        MbGarbageCollection::Run(true);
+        Math::SetMultithreadedMode(mode);
+    }
+
+    for (MbSpaceItem* item : items)
+    {
+        if (item != nullptr)
+            show(style, item);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void parallel_show(size_t count, const std::function<MbSpaceItem*(size_t index)>& build)
+{
+    parallel_show(Style(), count, build);
+}
+
 void message(const std::string& msg)
 {
     messages.push_back(msg);
@@ -196,64 +280,99 @@ void messageBox(const std::string& msg)
     messageBoxes.push_back({ "Message", msg });
 }
 
-extern "C"
+static bool entryPoint()
 {
-    FUNC(std::size_t) get_models_size()
+    try
     {
-        return models.size();
-    }
+        bool res = run();
+        return res;
 
-    FUNC(Model*) get_model(int index)
-    {
-        return &models[index];
     }
-
-    FUNC(bool) entry_point()
+    catch (std::exception& exp)
     {
-        try
-        {
-            bool res = run();
-            return res;
-
-        }
-        catch (std::exception& exp)
-        {
-            messageBox("Error", exp.what());
-            return false;
-        }
-        catch (...)
-        {
-            messageBox("Error", "...");
-            return false;
-        }
+        messageBox("Error", exp.what());
+        return false;
     }
-
-    FUNC(std::size_t) get_messages_size()
+    catch (...)
     {
-        return messages.size();
+        messageBox("Error", "...");
+        return false;
     }
+}
 
-    FUNC(const char*) get_message(int index)
+//------------------------------------------------------------------------------
+// Header, models, text ranges and text arena in one allocation, see resultblock.h.
+// The references addModels took on the items go along with it.
+// ---
+static ResultBlock* packResults(bool isOk)
+{
+    std::vector<const std::string*> texts;
+    for (const std::string& msg : messages)
+        texts.push_back(&msg);
+    for (const Pair& msg : messageBoxes)
     {
-        return messages[index].c_str();
+        texts.push_back(&msg.first);
+        texts.push_back(&msg.second);
     }
 
-    FUNC(std::size_t) get_messageBoxes_size()
+    size_t textSize = 0;
+    for (const std::string* text : texts)
+        textSize += text->size();
+
+    const size_t size = sizeof(ResultBlock) + models.size() * sizeof(ResultModel) + texts.size() * sizeof(ResultText) + textSize;
+    char* memory = static_cast<char*>(std::malloc(size));
+    if (memory == nullptr)
+        return nullptr;
+
+    ResultBlock* block = reinterpret_cast<ResultBlock*>(memory);
+    ResultModel* blockModels = reinterpret_cast<ResultModel*>(block + 1);
+    ResultText* blockTexts = reinterpret_cast<ResultText*>(blockModels + models.size());
+    char* arena = reinterpret_cast<char*>(blockTexts + texts.size());
+
+    block->version = RESULT_BLOCK_VERSION;
+    block->isOk = isOk ? 1 : 0;
+    block->modelCount = uint32_t(models.size());
+    block->messageCount = uint32_t(messages.size());
+    block->messageBoxCount = uint32_t(messageBoxes.size());
+    block->reserved = 0;
+    block->textSize = textSize;
+    block->models = blockModels;
+    block->texts = blockTexts;
+    block->textArena = arena;
+
+    for (const Model& model : models)
+        *blockModels++ = { uint32_t(model.style.getStyle()), uint32_t(model.style.getWidth()), model.style.getColor(), 0, model.item };
+
+    uint64_t offset = 0;
+    for (const std::string* text : texts)
     {
-        return messageBoxes.size();
+        *blockTexts++ = { offset, text->size() };
+        std::memcpy(arena + offset, text->data(), text->size());
+        offset += text->size();
     }
 
-    FUNC(const char*) get_messageBoxTitle(int index)
+    models.clear();
+    messages.clear();
+    messageBoxes.clear();
+    return block;
+}
+
+extern "C"
+{
+    FUNC(const ResultBlock*) run_user_code(uint32_t version)
     {
-        return messageBoxes[index].first.c_str();
+        if (version != RESULT_BLOCK_VERSION)
+            return nullptr;
+        return packResults(entryPoint());
     }
 
-    FUNC(const char*) get_messageBoxText(int index)
+    FUNC(void) free_results(const ResultBlock* block)
     {
-        return messageBoxes[index].second.c_str();
+        std::free(const_cast<ResultBlock*>(block));
     }
 }
 
+#ifdef _WIN32
 BOOL APIENTRY DllMain(HMODULE /*hModule*/,
     DWORD  ul_reason_for_call,
     LPVOID /*lpReserved*/)
@@ -272,4 +391,5 @@ BOOL APIENTRY DllMain(HMODULE /*hModule*/,
         break;
     }
     return TRUE;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+class MbItem;
+
+// Results of one run of the user code. dllmain.cpp packs them into one block
+// of memory the host reads without any further call into the library.
+//
+//   const ResultBlock* run_user_code(uint32_t version);
+//     Runs run() and returns the block, nullptr when the host expects another
+//     version. The block and one reference to each item go to the host.
+//   void free_results(const ResultBlock* block);
+//     Gives the memory back to the library; the items are not touched.
+
+#define RESULT_BLOCK_VERSION 1
+
+struct ResultModel
+{
+    uint32_t style;
+    uint32_t width;
+    uint32_t color;
+    uint32_t reserved;
+    MbItem*  item;
+};
+
+// A range of the text arena, UTF-8 without a terminating zero
+struct ResultText
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct ResultBlock
+{
+    uint32_t version;
+    uint32_t isOk;            // what run() returned
+    uint32_t modelCount;
+    uint32_t messageCount;    // the first texts
+    uint32_t messageBoxCount; // two texts each after the messages, the title and the text
+    uint32_t reserved;
+    uint64_t textSize;
+    const ResultModel* models;
+    const ResultText*  texts;
+    const char*        textArena;
+};
@@ -1,8 +1,11 @@
 #pragma once
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 #include <vector>
 #include <string>
+#include <functional>
 
 #include <reference_item.h>
 #include <plane_item.h>
@@ -154,4 +157,13 @@ void message(const std::string& msg);
 void messageBox(const std::string& title, const std::string& msg);
 void messageBox(const std::string& msg);
 
+// Calls build(0) ... build(count - 1) on all cores and shows what they return, in
+// the order of the indices. The calls must not depend on each other; nullptr
+// shows nothing. An exception of one call is rethrown once all of them ended.
+// build runs on several threads at once, so it must not call show, message or
+// messageBox: they are not synchronized. Return the item to be shown instead.
+//   parallel_show(100, [](size_t i) -> MbSpaceItem* { return makeGear(i); });
+void parallel_show(size_t count, const std::function<MbSpaceItem*(size_t index)>& build);
+void parallel_show(const Style& style, size_t count, const std::function<MbSpaceItem*(size_t index)>& build);
+
 bool run();
\ No newline at end of file
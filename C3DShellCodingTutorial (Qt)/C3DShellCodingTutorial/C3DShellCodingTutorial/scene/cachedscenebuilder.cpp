@@ -0,0 +1,32 @@
+﻿#include <solid.h>
+#include <mesh.h>
+#include <mb_data.h>
+
+#include "cachedscenebuilder.h"
+
+//-----------------------------------------------------------------------------
+// 
+// ---
+CachedSceneBuilder::CachedSceneBuilder(MbModel* pModel, SceneSegment* pTopSegment, const MeshCache& cache)
+    : SceneRepresentationBuilder(pModel, pTopSegment)
+    , m_cache(cache)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Called from the parallel tessellation loop; MeshCache serializes writers of
+// the same key and its eviction itself, so no locking is needed here. The key
+// includes the sag, so every level of detail has its own entry.
+// ---
+MbItem* CachedSceneBuilder::CreateMesh(const MbSolid* pSolid, const MbStepData& stepData) const
+{
+    const QByteArray key = MeshCache::solidKey(pSolid, stepData);
+
+    if (MbMesh* pMesh = m_cache.load(key))
+        return pMesh;
+
+    MbItem* pItem = SceneRepresentationBuilder::CreateMesh(pSolid, stepData);
+    if (pItem != nullptr && pItem->IsA() == st_Mesh)
+        m_cache.store(key, static_cast<const MbMesh&>(*pItem));
+    return pItem;
+}
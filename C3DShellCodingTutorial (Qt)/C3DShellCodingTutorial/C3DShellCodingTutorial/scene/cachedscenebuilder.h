@@ -0,0 +1,18 @@
+﻿#pragma once
+#include <vsn_scenerepbuilder.h>
+
+#include "meshcache.h"
+
+// Scene builder that takes solid meshes from a MeshCache and tessellates only
+// the solids that have no entry yet.
+class CachedSceneBuilder : public SceneRepresentationBuilder
+{
+public:
+    CachedSceneBuilder(MbModel* pModel, SceneSegment* pTopSegment, const MeshCache& cache);
+
+protected:
+    MbItem* CreateMesh(const MbSolid* pSolid, const MbStepData& stepData) const override;
+
+private:
+    const MeshCache& m_cache;
+};
@@ -0,0 +1,79 @@
+﻿#include <cmath>
+
+#include <vsn_scenesegment.h>
+
+#include "lodselector.h"
+
+// Largest on-screen deviation of a level from the true surface, in pixels.
+static const double c_pixelError = 1.0;
+// A coarser level is taken only when its error is below this part of the budget.
+static const double c_coarsenMargin = 0.7;
+
+//-----------------------------------------------------------------------------
+// Row vector convention of MbMatrix3D, the clip w of a point is its product
+// with the last column. A perspective projection has a nonzero El(2, 3).
+// ---
+void LodSelector::select(std::vector<LodGroup>& groups, const MbMatrix3D& viewProjection, const MbMatrix3D& projection, int viewportHeight)
+{
+    const bool isPerspective = std::fabs(projection.El(2, 3)) > 1.0e-12;
+    const double pixelsPerUnit = 0.5 * viewportHeight * std::fabs(projection.El(1, 1));
+
+    for (LodGroup& group : groups)
+    {
+        const int levelCount = int(group.segments.size());
+        if (levelCount == 0 || group.gabarit.IsEmpty())
+        {
+            setLevel(group, 0);
+            continue;
+        }
+
+        MbCartPoint3D center;
+        group.gabarit.GetCenter(center);
+        const double radius = 0.5 * group.gabarit.GetDiagonal();
+        double w = center.x * viewProjection.El(0, 3) + center.y * viewProjection.El(1, 3) +
+                   center.z * viewProjection.El(2, 3) + viewProjection.El(3, 3);
+        if (isPerspective)
+            w -= radius;
+
+        int level = 0;
+        if (w > 1.0e-9)
+        {
+            const double scale = pixelsPerUnit / w;
+            for (int i = levelCount - 1; i > 0; --i)
+            {
+                const double budget = i > group.level ? c_pixelError * c_coarsenMargin : c_pixelError;
+                if (group.sags[i] * scale <= budget)
+                {
+                    level = i;
+                    break;
+                }
+            }
+        }
+        setLevel(group, level);
+    }
+}
+
+bool LodSelector::isHidden(const NodeKey& key) const
+{
+    return !m_hidden.empty() && m_hidden.count(key.GetKey()) != 0;
+}
+
+void LodSelector::clear()
+{
+    m_hidden.clear();
+}
+
+void LodSelector::setLevel(LodGroup& group, int level)
+{
+    if (group.level == level)
+        return;
+    for (int i = 0; i < int(group.segments.size()); ++i)
+    {
+        const uint64 key = group.segments[i]->GetUniqueKey().GetKey();
+        if (i == level)
+            m_hidden.erase(key);
+        else
+            m_hidden.insert(key);
+    }
+    group.level = level;
+}
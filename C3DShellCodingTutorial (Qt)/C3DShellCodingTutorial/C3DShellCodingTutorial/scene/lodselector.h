@@ -0,0 +1,28 @@
+﻿#pragma once
+#include <unordered_set>
+#include <vector>
+
+#include <mb_matrix3d.h>
+#include <vsn_scenerepbuilder.h>
+
+VSN_USE_NAMESPACE
+
+// Chooses the level of detail every part is drawn with. The error of a level is
+// its tessellation sag projected to pixels at the near side of the bounding
+// sphere of the part; the coarsest level within the pixel budget is shown.
+// Going coarser needs some margin below the budget, so a part resting near the
+// limit does not flip between two levels while the camera moves.
+class LodSelector
+{
+public:
+    void select(std::vector<LodGroup>& groups, const MbMatrix3D& viewProjection, const MbMatrix3D& projection, int viewportHeight);
+    // Segments of the levels that are not chosen; VisibilityCuller hides them.
+    bool isHidden(const NodeKey& key) const;
+    void clear();
+
+private:
+    void setLevel(LodGroup& group, int level);
+
+private:
+    std::unordered_set<uint64> m_hidden;
+};
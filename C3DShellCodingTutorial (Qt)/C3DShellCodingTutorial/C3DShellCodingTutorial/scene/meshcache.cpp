@@ -0,0 +1,361 @@
+﻿#include <cstring>
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include <solid.h>
+#include <mesh.h>
+#include <mesh_grid.h>
+#include <mb_data.h>
+#include <io_tape.h>
+#include <io_memory_buffer.h>
+
+#include "globaldef.h"
+#include "meshcache.h"
+
+static const quint32 kMeshCacheMagic = 0x4D443343; // "C3DM"
+static const quint32 kMeshCacheVersion = 1;
+
+struct MeshCacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 meshType;
+    quint32 gridCount;
+};
+
+struct MeshCacheGridHeader
+{
+    quint32 name;
+    quint32 type;
+    quint32 pointCount;
+    quint32 indexCount;
+};
+
+QMutex MeshCache::s_writingMutex;
+QSet<QString> MeshCache::s_writing;
+
+//-----------------------------------------------------------------------------
+// 
+// ---
+MeshCache::MeshCache(const QString& dirPath)
+    : m_dirPath(dirPath)
+{
+    QDir dir(m_dirPath);
+    m_isValid = dir.exists() || dir.mkpath(".");
+    if (m_isValid)
+    {
+        for (const QFileInfo& info : dir.entryInfoList({ "*.mesh" }, QDir::Files))
+            m_size += info.size();
+        if (m_size > g_kDefaultMeshCacheSizeLimit)
+            evict();
+    }
+}
+
+bool MeshCache::isValid() const
+{
+    return m_isValid;
+}
+
+QString MeshCache::dirPath() const
+{
+    return m_dirPath;
+}
+
+QString MeshCache::entryPath(const QByteArray& key) const
+{
+    return QString("%1/%2.mesh").arg(m_dirPath).arg(QString::fromLatin1(key.toHex()));
+}
+
+//-----------------------------------------------------------------------------
+// Native kernel stream of the item, empty when it cannot be written.
+// ---
+QByteArray MeshCache::itemData(const MbItem* pItem)
+{
+    QByteArray data;
+    if (pItem == nullptr)
+        return data;
+
+    membuf memBuf;
+    {
+        writer::writer_ptr out = writer::CreateMemWriter(memBuf, io::out);
+        if (!out || !out->good())
+            return data;
+        *out << pItem;
+        if (!out->good())
+            return data;
+    }
+    memBuf.closeBuff();
+
+    size_t memLen = memBuf.getMemLen();
+    data.resize(static_cast<int>(memLen));
+    const char* pBuffer = data.data();
+    memBuf.toMemory(pBuffer, memLen);
+    return data;
+}
+
+//-----------------------------------------------------------------------------
+// The key covers the serialized solid and every step parameter, so a changed
+// body or a different sag never hits an old entry.
+// ---
+QByteArray MeshCache::solidKey(const MbSolid* pSolid, const MbStepData& stepData)
+{
+    const QByteArray data = itemData(pSolid);
+    if (data.isEmpty())
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(data);
+
+    QByteArray params;
+    QDataStream stream(&params, QIODevice::WriteOnly);
+    stream << kMeshCacheVersion
+        << stepData.GetSag() << stepData.GetAngle() << stepData.GetLength()
+        << static_cast<quint64>(stepData.GetMaxCount());
+    for (MbeStepType type : { ist_SpaceStep, ist_DeviationStep, ist_MetricStep, ist_ParamStep, ist_CollisionStep, ist_MipStep })
+        stream << stepData.StepIs(type);
+    hash.addData(params);
+
+    return hash.result();
+}
+
+//-----------------------------------------------------------------------------
+// 
+// ---
+MbMesh* MeshCache::load(const QByteArray& key) const
+{
+    if (!m_isValid || key.isEmpty())
+        return nullptr;
+
+    QFile file(entryPath(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 size = file.size();
+    const uchar* pData = file.map(0, size);
+    if (pData == nullptr)
+        return nullptr;
+
+    const uchar* pEnd = pData + size;
+    const uchar* pCur = pData;
+
+    MeshCacheHeader header;
+    if (pEnd - pCur < static_cast<qint64>(sizeof(header)))
+        return nullptr;
+    std::memcpy(&header, pCur, sizeof(header));
+    pCur += sizeof(header);
+    if (header.magic != kMeshCacheMagic || header.version != kMeshCacheVersion)
+        return nullptr;
+
+    MbMesh* pMesh = new MbMesh(false);
+    pMesh->SetMeshType(static_cast<MbeSpaceType>(header.meshType));
+
+    bool isValid = true;
+    for (quint32 i = 0; i < header.gridCount && isValid; ++i)
+    {
+        MeshCacheGridHeader gridHeader;
+        if (pEnd - pCur < static_cast<qint64>(sizeof(gridHeader)))
+        {
+            isValid = false;
+            break;
+        }
+        std::memcpy(&gridHeader, pCur, sizeof(gridHeader));
+        pCur += sizeof(gridHeader);
+
+        const qint64 pointsSize = qint64(gridHeader.pointCount) * 3 * sizeof(float);
+        const qint64 indexSize = qint64(gridHeader.indexCount) * sizeof(quint32);
+        if (gridHeader.indexCount % 3 != 0 || pEnd - pCur < 2 * pointsSize + indexSize)
+        {
+            isValid = false;
+            break;
+        }
+
+        const float* pPoints = reinterpret_cast<const float*>(pCur);
+        const float* pNormals = reinterpret_cast<const float*>(pCur + pointsSize);
+        const quint32* pIndices = reinterpret_cast<const quint32*>(pCur + 2 * pointsSize);
+        pCur += 2 * pointsSize + indexSize;
+
+        MbGrid* pGrid = pMesh->AddGrid();
+        if (pGrid == nullptr)
+        {
+            isValid = false;
+            break;
+        }
+        pGrid->SetPrimitiveName(static_cast<SimpleName>(gridHeader.name));
+        pGrid->SetPrimitiveType(static_cast<MbeRefType>(gridHeader.type));
+        pGrid->ReservePointsNormals(gridHeader.pointCount);
+        pGrid->TrianglesReserve(gridHeader.indexCount / 3);
+
+        MbFloatPoint3D point;
+        MbFloatVector3D normal;
+        for (quint32 j = 0; j < gridHeader.pointCount; ++j)
+        {
+            std::memcpy(&point.x, pPoints + 3 * j, 3 * sizeof(float));
+            std::memcpy(&normal.x, pNormals + 3 * j, 3 * sizeof(float));
+            pGrid->AddPoint(point, normal);
+        }
+        for (quint32 j = 0; j < gridHeader.indexCount; j += 3)
+        {
+            quint32 tri[3];
+            std::memcpy(tri, pIndices + j, sizeof(tri));
+            if (tri[0] >= gridHeader.pointCount || tri[1] >= gridHeader.pointCount || tri[2] >= gridHeader.pointCount)
+            {
+                isValid = false;
+                break;
+            }
+            pGrid->AddTriangle(tri[0], tri[1], tri[2], true);
+        }
+    }
+
+    if (!isValid)
+    {
+        delete pMesh;
+        return nullptr;
+    }
+
+    // the modification time is the last use, evict() drops the oldest first
+    file.close();
+    if (file.open(QIODevice::Append))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return pMesh;
+}
+
+//-----------------------------------------------------------------------------
+// Only triangulated grids with a normal per point are stored; wires and apexes
+// are left to the tessellator. Identical solids share a key, so an entry that
+// already exists or is being written by another thread is not written again.
+// ---
+bool MeshCache::store(const QByteArray& key, const MbMesh& mesh) const
+{
+    if (!m_isValid || key.isEmpty() || mesh.PolygonsCount() != 0 || mesh.ApexesCount() != 0)
+        return false;
+
+    const size_t gridCount = mesh.GridsCount();
+    for (size_t i = 0; i < gridCount; ++i)
+    {
+        const MbGrid* pGrid = mesh.GetGrid(i);
+        if (pGrid == nullptr || pGrid->NormalsCount() != pGrid->PointsCount())
+            return false;
+    }
+
+    const QString path = entryPath(key);
+    {
+        QMutexLocker locker(&s_writingMutex);
+        if (s_writing.contains(path) || QFile::exists(path))
+            return false;
+        s_writing.insert(path);
+    }
+
+    const bool isStored = writeEntry(path, mesh);
+    {
+        QMutexLocker locker(&s_writingMutex);
+        s_writing.remove(path);
+    }
+    if (!isStored)
+        return false;
+
+    bool isFull = false;
+    {
+        QMutexLocker locker(&m_sizeMutex);
+        m_size += QFileInfo(path).size();
+        isFull = m_size > g_kDefaultMeshCacheSizeLimit;
+    }
+    if (isFull)
+        evict();
+    return true;
+}
+
+bool MeshCache::writeEntry(const QString& path, const MbMesh& mesh) const
+{
+    const size_t gridCount = mesh.GridsCount();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    MeshCacheHeader header = { kMeshCacheMagic, kMeshCacheVersion,
+        static_cast<quint32>(mesh.GetMeshType()), static_cast<quint32>(gridCount) };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<float> points;
+    std::vector<float> normals;
+    std::vector<quint32> indices;
+    for (size_t i = 0; i < gridCount; ++i)
+    {
+        const MbGrid* pGrid = mesh.GetGrid(i);
+        const size_t pointCount = pGrid->PointsCount();
+
+        points.resize(3 * pointCount);
+        normals.resize(3 * pointCount);
+        MbFloatPoint3D point;
+        MbFloatVector3D normal;
+        for (size_t j = 0; j < pointCount; ++j)
+        {
+            pGrid->GetPoint(j, point);
+            pGrid->GetNormal(j, normal);
+            std::memcpy(&points[3 * j], &point.x, 3 * sizeof(float));
+            std::memcpy(&normals[3 * j], &normal.x, 3 * sizeof(float));
+        }
+
+        indices.clear();
+        indices.reserve(3 * (pGrid->TrianglesCount() + 2 * pGrid->QuadranglesCount()));
+        uint i0 = 0, i1 = 0, i2 = 0, i3 = 0;
+        for (size_t j = 0, count = pGrid->TrianglesCount(); j < count; ++j)
+        {
+            if (pGrid->GetTriangleIndex(j, i0, i1, i2))
+                indices.insert(indices.end(), { i0, i1, i2 });
+        }
+        for (size_t j = 0, count = pGrid->QuadranglesCount(); j < count; ++j)
+        {
+            if (pGrid->GetQuadrangleIndex(j, i0, i1, i2, i3))
+                indices.insert(indices.end(), { i0, i1, i2, i0, i2, i3 });
+        }
+
+        MeshCacheGridHeader gridHeader = { static_cast<quint32>(pGrid->GetPrimitiveName()),
+            static_cast<quint32>(pGrid->GetPrimitiveType()),
+            static_cast<quint32>(pointCount), static_cast<quint32>(indices.size()) };
+        file.write(reinterpret_cast<const char*>(&gridHeader), sizeof(gridHeader));
+        file.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(float));
+        file.write(reinterpret_cast<const char*>(normals.data()), normals.size() * sizeof(float));
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(quint32));
+    }
+
+    return file.commit();
+}
+
+//-----------------------------------------------------------------------------
+// Removes the least recently used entries until the directory is down to three
+// quarters of the limit, so the next few stores do not scan it again. Entries
+// that cannot be removed (still mapped elsewhere) are only counted.
+// ---
+void MeshCache::evict() const
+{
+    QMutexLocker locker(&m_sizeMutex);
+
+    QFileInfoList entries = QDir(m_dirPath).entryInfoList({ "*.mesh" }, QDir::Files);
+    std::sort(entries.begin(), entries.end(), [](const QFileInfo& lhs, const QFileInfo& rhs)
+    {
+        return lhs.lastModified() < rhs.lastModified();
+    });
+
+    qint64 size = 0;
+    for (const QFileInfo& info : entries)
+        size += info.size();
+
+    const qint64 target = g_kDefaultMeshCacheSizeLimit / 4 * 3;
+    for (const QFileInfo& info : entries)
+    {
+        if (size <= target)
+            break;
+        if (QFile::remove(info.absoluteFilePath()))
+            size -= info.size();
+    }
+    m_size = size;
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QSet>
+#include <QMutex>
+
+class MbItem;
+class MbMesh;
+class MbSolid;
+class MbStepData;
+
+// Directory of tessellated solids. An entry holds the float32 points, normals
+// and triangle indices of every grid and is mapped straight from disk on load.
+// The directory is kept under g_kDefaultMeshCacheSizeLimit by dropping the
+// least recently used entries.
+class MeshCache
+{
+public:
+    explicit MeshCache(const QString& dirPath);
+
+public:
+    bool isValid() const;
+    QString dirPath() const;
+
+    static QByteArray itemData(const MbItem* pItem);
+    static QByteArray solidKey(const MbSolid* pSolid, const MbStepData& stepData);
+    MbMesh* load(const QByteArray& key) const;
+    bool store(const QByteArray& key, const MbMesh& mesh) const;
+
+private:
+    QString entryPath(const QByteArray& key) const;
+    bool writeEntry(const QString& path, const MbMesh& mesh) const;
+    void evict() const;
+
+private:
+    QString m_dirPath;
+    bool m_isValid = false;
+    mutable QMutex m_sizeMutex;
+    mutable qint64 m_size = 0;
+    static QMutex s_writingMutex;
+    static QSet<QString> s_writing;
+};
@@ -0,0 +1,71 @@
+﻿#include <QFile>
+#include <QFileInfo>
+
+#include <model.h>
+
+#include "modelloader.h"
+
+ModelLoader::ModelLoader(const QString& fileName)
+    : m_fileName(fileName)
+{
+}
+
+//-----------------------------------------------------------------------------
+// A model that was not taken by the scene is dropped with the loader.
+// ---
+ModelLoader::~ModelLoader()
+{
+    release();
+}
+
+void ModelLoader::cancel()
+{
+    m_isCanceled = true;
+}
+
+bool ModelLoader::isCanceled() const
+{
+    return m_isCanceled;
+}
+
+QString ModelLoader::fileName() const
+{
+    return m_fileName;
+}
+
+MbModel* ModelLoader::takeModel()
+{
+    MbModel* pModel = m_pModel;
+    m_pModel = nullptr;
+    return pModel;
+}
+
+void ModelLoader::release()
+{
+    ::DeleteItem(m_pModel);
+}
+
+//-----------------------------------------------------------------------------
+// Cancellation is checked between the phases; a canceled load finishes empty.
+// ---
+void ModelLoader::process()
+{
+    QFile file(m_fileName);
+    if (!m_isCanceled && file.open(QFile::ReadOnly))
+    {
+        emit progress(tr("Reading %1").arg(QFileInfo(m_fileName).fileName()));
+
+        // the kernel reads the model straight from the mapped pages
+        const qint64 size = file.size();
+        if (uchar* pData = file.map(0, size))
+        {
+            m_pModel = SceneGenerator::Instance()->LoadModel(reinterpret_cast<const char*>(pData), size_t(size));
+            file.unmap(pData);
+        }
+        file.close();
+    }
+
+    if (m_isCanceled)
+        release();
+    emit finished();
+}
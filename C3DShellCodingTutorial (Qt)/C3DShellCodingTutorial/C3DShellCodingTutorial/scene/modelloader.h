@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <atomic>
+
+#include <QObject>
+#include <QString>
+
+#include <vsn_vision.h>
+
+VSN_USE_NAMESPACE
+
+class MbModel;
+
+// Loads a .c3d file on a worker thread. The file is mapped into memory and read
+// by the kernel in place.
+class ModelLoader : public QObject {
+    Q_OBJECT
+public:
+    explicit ModelLoader(const QString& fileName);
+    ~ModelLoader() override;
+
+    void cancel();
+    bool isCanceled() const;
+
+    QString fileName() const;
+    MbModel* takeModel();
+
+public slots:
+    void process();
+signals:
+    void progress(const QString& stage);
+    void finished();
+private:
+    void release();
+private:
+    const QString m_fileName;
+    MbModel* m_pModel = nullptr;
+    std::atomic<bool> m_isCanceled = { false };
+};
@@ -0,0 +1,495 @@
+﻿#include <algorithm>
+#include <climits>
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+
+#include <vsn_meshgeometry.h>
+#include <vsn_wireframegeometry.h>
+
+#include "pickbuffer.h"
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+// Edges and vertices are found this many pixels away from the cursor.
+static const int c_pickRadius = 4;
+static const float c_vertexSize = 7.0f;
+
+static const char* c_vertexShader =
+    "attribute highp vec3 position;\n"
+    "uniform highp mat4 matrix;\n"
+    "uniform highp float pointSize;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = matrix * vec4(position, 1.0);\n"
+    "    gl_PointSize = pointSize;\n"
+    "}\n";
+
+static const char* c_fragmentShader =
+    "uniform lowp vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+PickBuffer::Shape::Shape()
+    : faceVertices(QOpenGLBuffer::VertexBuffer)
+    , faceIndices(QOpenGLBuffer::IndexBuffer)
+    , lineVertices(QOpenGLBuffer::VertexBuffer)
+{
+}
+
+PickBuffer::PickBuffer()
+{
+}
+
+PickBuffer::~PickBuffer()
+{
+    for (auto& shape : m_shapes)
+        delete shape.second;
+    delete m_pFbo;
+    delete m_pProgram;
+}
+
+void PickBuffer::setBodyPicking(bool bodies)
+{
+    if (m_isBodyPicking == bodies)
+        return;
+    m_isBodyPicking = bodies;
+    m_isValid = false;
+}
+
+void PickBuffer::invalidate()
+{
+    m_isValid = false;
+}
+
+void PickBuffer::release()
+{
+    for (auto& shape : m_shapes)
+    {
+        shape.second->faceVertices.destroy();
+        shape.second->faceIndices.destroy();
+        shape.second->lineVertices.destroy();
+        delete shape.second;
+    }
+    m_shapes.clear();
+    m_ids.clear();
+    m_vao.destroy();
+    delete m_pFbo;
+    m_pFbo = nullptr;
+    delete m_pProgram;
+    m_pProgram = nullptr;
+    m_isValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// Vertices win over edges and edges over faces; a face has to be right under
+// the cursor. Among hits of one kind the one nearest to the cursor is taken.
+// ---
+PickBuffer::Hit PickBuffer::pick(QOpenGLContext* pContext, RenderContainer& container, const MbMatrix3D& viewProjection, const QSize& size, const QPoint& pos)
+{
+    if (pContext == nullptr || size.isEmpty() || !ensureProgram())
+        return Hit();
+    if (!m_isValid || m_pFbo == nullptr || m_pFbo->size() != size || !(m_viewProjection == viewProjection))
+    {
+        m_viewProjection = viewProjection;
+        render(pContext, container, size);
+    }
+
+    // window rows go down, framebuffer rows go up
+    const int cx = pos.x();
+    const int cy = size.height() - 1 - pos.y();
+    const int x0 = std::max(0, cx - c_pickRadius);
+    const int y0 = std::max(0, cy - c_pickRadius);
+    const int x1 = std::min(size.width() - 1, cx + c_pickRadius);
+    const int y1 = std::min(size.height() - 1, cy + c_pickRadius);
+    if (x0 > x1 || y0 > y1)
+        return Hit();
+
+    const int width = x1 - x0 + 1;
+    const int height = y1 - y0 + 1;
+    std::vector<uchar> pixels(size_t(width) * height * 4);
+    QOpenGLFunctions* pFunctions = pContext->functions();
+    m_pFbo->bind();
+    pFunctions->glReadPixels(x0, y0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    m_pFbo->release();
+
+    Hit best;
+    int bestRank = 0;
+    int bestDistance = INT_MAX;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const uchar* pPixel = pixels.data() + (size_t(y) * width + x) * 4;
+            const uint id = uint(pPixel[0]) | (uint(pPixel[1]) << 8) | (uint(pPixel[2]) << 16);
+            if (id == 0 || id >= m_ids.size())
+                continue;
+
+            const Hit& hit = m_ids[id];
+            const int dx = x0 + x - cx, dy = y0 + y - cy;
+            const int distance = dx * dx + dy * dy;
+            int rank = hit.type == ObjectType::Vertex ? 3 : hit.type == ObjectType::Edge ? 2 : 1;
+            if (rank == 1 && distance != 0)
+                continue;
+            if (rank > bestRank || (rank == bestRank && distance < bestDistance))
+            {
+                best = hit;
+                bestRank = rank;
+                bestDistance = distance;
+            }
+        }
+    }
+    return best;
+}
+
+//-----------------------------------------------------------------------------
+// Draws the hit over the frame just rendered, in the current framebuffer.
+// ---
+void PickBuffer::drawHighlight(QOpenGLContext* pContext, const MbMatrix3D& viewProjection, const Hit& hit, const Color& color)
+{
+    auto it = m_shapes.find(hit.key.GetKey());
+    if (pContext == nullptr || hit.type == ObjectType::None || it == m_shapes.end() || !ensureProgram())
+        return;
+
+    QOpenGLFunctions* pFunctions = pContext->functions();
+    GLint depthFunc = GL_LESS;
+    pFunctions->glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    pFunctions->glEnable(GL_DEPTH_TEST);
+    pFunctions->glDepthFunc(GL_LEQUAL);
+    pFunctions->glPolygonOffset(-1.0f, -1.0f);
+    if (!pContext->isOpenGLES())
+        pFunctions->glEnable(GL_PROGRAM_POINT_SIZE);
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    m_pProgram->bind();
+    draw(pContext, *it->second, viewProjection, hit.type, hit.index, color);
+    m_pProgram->release();
+    pFunctions->glDepthFunc(GLenum(depthFunc));
+}
+
+bool PickBuffer::ensureProgram()
+{
+    if (m_pProgram != nullptr)
+        return m_pProgram->isLinked();
+
+    if (!m_vao.isCreated())
+        m_vao.create();
+    m_pProgram = new QOpenGLShaderProgram;
+    m_pProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, c_vertexShader);
+    m_pProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, c_fragmentShader);
+    m_pProgram->bindAttributeLocation("position", 0);
+    return m_pProgram->link();
+}
+
+//-----------------------------------------------------------------------------
+// Vision keeps the triangles of a mesh grouped by material, one group per face
+// of a solid, so a group is what gets picked as a face.
+// ---
+static void appendFaces(const MeshGeometry& mesh, std::vector<float>& vertices, std::vector<uint>& indices, std::vector<PickBuffer::Range>& faces)
+{
+    const std::vector<float> positions = mesh.GetPositions();
+    if (positions.empty())
+        return;
+    const uint base = uint(vertices.size() / 3);
+    vertices.insert(vertices.end(), positions.begin(), positions.end());
+
+    for (const NodeKey& materialId : mesh.GetMaterialIds())
+    {
+        PickBuffer::Range face;
+        face.first = int(indices.size());
+        for (uint index : mesh.GetTriIndices(0, materialId))
+            indices.push_back(base + index);
+        for (const std::vector<uint>& strip : mesh.GetTriStripsIndex(0, materialId))
+        {
+            for (size_t i = 2; i < strip.size(); ++i)
+            {
+                indices.push_back(base + strip[i - 2]);
+                indices.push_back(base + strip[i - 1]);
+                indices.push_back(base + strip[i]);
+            }
+        }
+        for (const std::vector<uint>& fan : mesh.GetTriFansIndex(0, materialId))
+        {
+            for (size_t i = 2; i < fan.size(); ++i)
+            {
+                indices.push_back(base + fan[0]);
+                indices.push_back(base + fan[i - 1]);
+                indices.push_back(base + fan[i]);
+            }
+        }
+        face.count = int(indices.size()) - face.first;
+        if (face.count > 0)
+            faces.push_back(face);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Every polyline is an edge; its two ends are the vertices.
+// ---
+static void appendEdges(const WireframeGeometry& geometry, std::vector<float>& vertices, std::vector<PickBuffer::Range>& edges, std::vector<int>& ends)
+{
+    const std::vector<float> positions = geometry.GetWireFrameVertexPositions();
+    const int pointCount = int(positions.size() / 3);
+    if (pointCount == 0)
+        return;
+    const int base = int(vertices.size() / 3);
+    vertices.insert(vertices.end(), positions.begin(), positions.end());
+
+    for (int i = 0, count = geometry.GetPolylineCount(); i < count; ++i)
+    {
+        PickBuffer::Range edge;
+        edge.first = int(geometry.GetPolylineOffset(i));
+        edge.count = geometry.GetPolylineSize(i);
+        if (edge.count < 2 || edge.first < 0 || edge.first + edge.count > pointCount)
+            continue;
+        edge.first += base;
+        edges.push_back(edge);
+        ends.push_back(edge.first);
+        ends.push_back(edge.first + edge.count - 1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Geometry kept in video memory only is copied back once for the buffers here.
+// ---
+PickBuffer::Shape* PickBuffer::shape(RenderObject* pObject)
+{
+    const uint64 key = pObject->GetUniqueKey().GetKey();
+    auto it = m_shapes.find(key);
+    if (it != m_shapes.end())
+        return it->second;
+
+    std::vector<float> faceVertices, lineVertices;
+    std::vector<uint> faceIndices;
+    Shape* pShape = new Shape;
+    for (size_t i = 0, count = pObject->GetGeometryCount(); i < count; ++i)
+    {
+        WireframeGeometry* pGeometry = pObject->GetGeometryByIndex(i);
+        if (pGeometry == nullptr)
+            continue;
+        const bool isServerSide = pGeometry->IsUsedVertexBuffer();
+        if (isServerSide)
+            pGeometry->CopyVertexBufferToClientSide();
+        if (const MeshGeometry* pMesh = dynamic_cast<const MeshGeometry*>(pGeometry))
+            appendFaces(*pMesh, faceVertices, faceIndices, pShape->faces);
+        appendEdges(*pGeometry, lineVertices, pShape->edges, pShape->vertices);
+        if (isServerSide)
+            pGeometry->ReleaseVertexBufferClientSide(false);
+    }
+
+    if (!faceIndices.empty())
+    {
+        pShape->faceVertices.create();
+        pShape->faceVertices.bind();
+        pShape->faceVertices.allocate(faceVertices.data(), int(faceVertices.size() * sizeof(float)));
+        pShape->faceVertices.release();
+        pShape->faceIndices.create();
+        pShape->faceIndices.bind();
+        pShape->faceIndices.allocate(faceIndices.data(), int(faceIndices.size() * sizeof(uint)));
+        pShape->faceIndices.release();
+    }
+    if (!lineVertices.empty())
+    {
+        pShape->lineVertices.create();
+        pShape->lineVertices.bind();
+        pShape->lineVertices.allocate(lineVertices.data(), int(lineVertices.size() * sizeof(float)));
+        pShape->lineVertices.release();
+    }
+    m_shapes.emplace(key, pShape);
+    return pShape;
+}
+
+//-----------------------------------------------------------------------------
+// Faces are pushed back by the polygon offset, so that the edges on them and
+// the vertices at their ends pass the depth test.
+// ---
+void PickBuffer::render(QOpenGLContext* pContext, RenderContainer& container, const QSize& size)
+{
+    if (m_pFbo == nullptr || m_pFbo->size() != size)
+    {
+        delete m_pFbo;
+        m_pFbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::Depth);
+    }
+
+    // the state Vision may rely on in its next frame
+    QOpenGLFunctions* pFunctions = pContext->functions();
+    GLfloat clearColor[4] = {};
+    GLint depthFunc = GL_LESS;
+    pFunctions->glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    pFunctions->glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    const GLboolean isBlend = pFunctions->glIsEnabled(GL_BLEND);
+    const GLboolean isCullFace = pFunctions->glIsEnabled(GL_CULL_FACE);
+
+    m_pFbo->bind();
+    pFunctions->glViewport(0, 0, size.width(), size.height());
+    pFunctions->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    pFunctions->glClearDepthf(1.0f);
+    pFunctions->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    pFunctions->glEnable(GL_DEPTH_TEST);
+    pFunctions->glDepthFunc(GL_LEQUAL);
+    pFunctions->glDisable(GL_BLEND);
+    pFunctions->glDisable(GL_CULL_FACE);
+    pFunctions->glPolygonOffset(1.0f, 1.0f);
+    if (!pContext->isOpenGLES())
+        pFunctions->glEnable(GL_PROGRAM_POINT_SIZE);
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(&m_vao);
+    m_pProgram->bind();
+    m_ids.assign(1, Hit());
+    ++m_stamp;
+    for (RenderObject* pObject : container.GetObjects())
+    {
+        auto it = m_shapes.find(pObject->GetUniqueKey().GetKey());
+        if (it != m_shapes.end())
+            it->second->stamp = m_stamp;
+        if (!pObject->IsVisible() || pObject->IsDisabledForPick())
+            continue;
+
+        Shape* pShape = shape(pObject);
+        pShape->stamp = m_stamp;
+        pShape->matrix = pObject->GetMatrix();
+        m_drawKey = pObject->GetUniqueKey();
+        draw(pContext, *pShape, m_viewProjection, ObjectType::None, -1, Color());
+    }
+    m_pProgram->release();
+    m_pFbo->release();
+
+    pFunctions->glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    pFunctions->glDepthFunc(GLenum(depthFunc));
+    if (isBlend)
+        pFunctions->glEnable(GL_BLEND);
+    if (isCullFace)
+        pFunctions->glEnable(GL_CULL_FACE);
+
+    // objects gone from the scene
+    for (auto it = m_shapes.begin(); it != m_shapes.end();)
+    {
+        if (it->second->stamp == m_stamp)
+        {
+            ++it;
+            continue;
+        }
+        it->second->faceVertices.destroy();
+        it->second->faceIndices.destroy();
+        it->second->lineVertices.destroy();
+        delete it->second;
+        it = m_shapes.erase(it);
+    }
+    m_isValid = true;
+}
+
+//-----------------------------------------------------------------------------
+// With ObjectType::None the whole shape is drawn into the ID buffer, a color
+// per face, edge and vertex; otherwise only the given part in the given color.
+// ---
+void PickBuffer::draw(QOpenGLContext* pContext, const Shape& shape, const MbMatrix3D& viewProjection, ObjectType type, int index, const Color& color)
+{
+    QOpenGLFunctions* pFunctions = pContext->functions();
+    const bool isIdPass = type == ObjectType::None;
+    setMatrix(viewProjection, shape.matrix);
+    m_pProgram->enableAttributeArray(0);
+    if (!isIdPass)
+        m_pProgram->setUniformValue("color", color.GetRedF(), color.GetGreenF(), color.GetBlueF(), 1.0f);
+
+    const bool drawFaces = isIdPass || type == ObjectType::Body || type == ObjectType::Face;
+    if (drawFaces && !shape.faces.empty())
+    {
+        pFunctions->glEnable(GL_POLYGON_OFFSET_FILL);
+        shape.faceVertices.bind();
+        shape.faceIndices.bind();
+        m_pProgram->setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        uint bodyId = 0;
+        for (int i = 0; i < int(shape.faces.size()); ++i)
+        {
+            if (type == ObjectType::Face && i != index)
+                continue;
+            if (isIdPass)
+            {
+                if (!m_isBodyPicking)
+                    setColor(addId(ObjectType::Face, i));
+                else
+                {
+                    if (bodyId == 0)
+                        bodyId = addId(ObjectType::Body, -1);
+                    setColor(bodyId);
+                }
+            }
+            const Range& face = shape.faces[i];
+            pFunctions->glDrawElements(GL_TRIANGLES, face.count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(size_t(face.first) * sizeof(uint)));
+        }
+        shape.faceIndices.release();
+        shape.faceVertices.release();
+        pFunctions->glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+
+    const bool drawEdges = (isIdPass && !m_isBodyPicking) || type == ObjectType::Edge || type == ObjectType::Vertex;
+    if (drawEdges && !shape.edges.empty())
+    {
+        shape.lineVertices.bind();
+        m_pProgram->setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        if (isIdPass || type == ObjectType::Edge)
+        {
+            for (int i = 0; i < int(shape.edges.size()); ++i)
+            {
+                if (type == ObjectType::Edge && i != index)
+                    continue;
+                if (isIdPass)
+                    setColor(addId(ObjectType::Edge, i));
+                pFunctions->glDrawArrays(GL_LINE_STRIP, shape.edges[i].first, shape.edges[i].count);
+            }
+        }
+        if (isIdPass || type == ObjectType::Vertex)
+        {
+            m_pProgram->setUniformValue("pointSize", c_vertexSize);
+            for (int i = 0; i < int(shape.vertices.size()); ++i)
+            {
+                if (type == ObjectType::Vertex && i != index)
+                    continue;
+                if (isIdPass)
+                    setColor(addId(ObjectType::Vertex, i));
+                pFunctions->glDrawArrays(GL_POINTS, shape.vertices[i], 1);
+            }
+        }
+        shape.lineVertices.release();
+    }
+    m_pProgram->disableAttributeArray(0);
+}
+
+//-----------------------------------------------------------------------------
+// 24 bits of color; parts past that many are not pickable.
+// ---
+uint PickBuffer::addId(ObjectType type, int index)
+{
+    if (m_ids.size() > 0xffffff)
+        return 0;
+    Hit hit;
+    hit.key = m_drawKey;
+    hit.type = type;
+    hit.index = index;
+    m_ids.push_back(hit);
+    return uint(m_ids.size() - 1);
+}
+
+void PickBuffer::setColor(uint id)
+{
+    m_pProgram->setUniformValue("color", (id & 0xff) / 255.0f, ((id >> 8) & 0xff) / 255.0f, ((id >> 16) & 0xff) / 255.0f, 1.0f);
+}
+
+//-----------------------------------------------------------------------------
+// Row vector convention of MbMatrix3D; laid out row by row it is the column
+// major transpose that GLSL multiplies from the left.
+// ---
+void PickBuffer::setMatrix(const MbMatrix3D& viewProjection, const MbMatrix3D& model)
+{
+    const MbMatrix3D matrix = model * viewProjection;
+    GLfloat values[4][4];
+    for (size_t i = 0; i < 4; ++i)
+        for (size_t j = 0; j < 4; ++j)
+            values[i][j] = GLfloat(matrix.El(i, j));
+    m_pProgram->setUniformValue("matrix", values);
+}
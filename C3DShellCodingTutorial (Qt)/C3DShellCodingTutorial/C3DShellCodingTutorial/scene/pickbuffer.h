@@ -0,0 +1,93 @@
+﻿#pragma once
+#include <unordered_map>
+#include <vector>
+
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QPoint>
+#include <QSize>
+
+#include <mb_matrix3d.h>
+#include <vsn_color.h>
+#include <vsn_rendercontainer.h>
+#include <vsn_renderobject.h>
+
+VSN_USE_NAMESPACE
+
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// Hover picking through an ID buffer. Every face, edge and vertex of the shown
+// objects is drawn with a color of its own into an offscreen buffer, and a pick
+// reads the pixels around the cursor. The buffer is drawn again only after the
+// camera or the scene changed, so a hover costs the same for any model size.
+// The geometry is copied from the render objects once and kept in buffers here.
+class PickBuffer
+{
+public:
+    struct Hit
+    {
+        NodeKey key;
+        ObjectType type = ObjectType::None;
+        int index = -1; // of the face, edge or vertex in the object
+
+        bool operator == (const Hit& other) const { return key == other.key && type == other.type && index == other.index; }
+        bool operator != (const Hit& other) const { return !(*this == other); }
+    };
+
+    struct Range
+    {
+        int first = 0;
+        int count = 0;
+    };
+
+    PickBuffer();
+    ~PickBuffer();
+
+    // Whole objects are picked instead of their faces, edges and vertices.
+    void setBodyPicking(bool bodies);
+    // The objects or their visibility changed since the last pick.
+    void invalidate();
+
+    // All of these need the OpenGL context current.
+    Hit pick(QOpenGLContext* pContext, RenderContainer& container, const MbMatrix3D& viewProjection, const QSize& size, const QPoint& pos);
+    void drawHighlight(QOpenGLContext* pContext, const MbMatrix3D& viewProjection, const Hit& hit, const Color& color);
+    void release();
+
+private:
+    // Geometry of one render object in its own coordinates.
+    struct Shape
+    {
+        QOpenGLBuffer faceVertices;
+        QOpenGLBuffer faceIndices;
+        std::vector<Range> faces;   // ranges of faceIndices
+        QOpenGLBuffer lineVertices;
+        std::vector<Range> edges;   // line strips in lineVertices
+        std::vector<int> vertices;  // edge ends in lineVertices
+        MbMatrix3D matrix;
+        int stamp = 0;
+
+        Shape();
+    };
+
+    bool ensureProgram();
+    Shape* shape(RenderObject* pObject);
+    void render(QOpenGLContext* pContext, RenderContainer& container, const QSize& size);
+    void draw(QOpenGLContext* pContext, const Shape& shape, const MbMatrix3D& viewProjection, ObjectType type, int index, const Color& color);
+    uint addId(ObjectType type, int index);
+    void setColor(uint id);
+    void setMatrix(const MbMatrix3D& viewProjection, const MbMatrix3D& model);
+
+private:
+    QOpenGLShaderProgram* m_pProgram = nullptr;
+    QOpenGLFramebufferObject* m_pFbo = nullptr;
+    QOpenGLVertexArrayObject m_vao;
+    std::unordered_map<uint64, Shape*> m_shapes;
+    std::vector<Hit> m_ids; // hit of every color drawn, 0 is the background
+    NodeKey m_drawKey;      // object drawn into the ID buffer
+    MbMatrix3D m_viewProjection;
+    int m_stamp = 0;
+    bool m_isBodyPicking = false;
+    bool m_isValid = false;
+};
@@ -0,0 +1,165 @@
+﻿#include <algorithm>
+
+#include <QThread>
+#include <QMetaObject>
+
+#include <model_item.h>
+#include <mb_cube.h>
+#include <tool_mutex.h>
+
+#include "progressivebuilder.h"
+
+// Meshes per part, VisionScene shows the coarsest one that looks right.
+static const size_t c_levelsOfDetail = 4;
+
+ProgressiveBuilder::ProgressiveBuilder(MbModel* pModel, SceneSegment* pTopSegment, const QString& cacheDir, QObject* parent)
+    : QObject(parent)
+    , m_meshCache(cacheDir)
+    , m_builder(pModel, pTopSegment, m_meshCache)
+{
+    m_builder.SetLevelsOfDetail(c_levelsOfDetail);
+}
+
+//-----------------------------------------------------------------------------
+// Meshes finished after cancel are dropped here.
+// ---
+ProgressiveBuilder::~ProgressiveBuilder()
+{
+    m_isCanceled = true;
+    joinWorkers();
+    for (auto& ready : m_ready)
+        SceneRepresentationBuilder::ReleaseMeshes(ready.second);
+}
+
+void ProgressiveBuilder::createProxies()
+{
+    m_builder.Prepare();
+    m_builder.CreateProxies();
+}
+
+//-----------------------------------------------------------------------------
+// A part is scheduled by its apparent size: the radius of its bounding sphere
+// over the distance from the eye to that sphere.
+// ---
+void ProgressiveBuilder::start(const MbCartPoint3D& eye)
+{
+    m_total = static_cast<int>(m_builder.GetSolidsCount());
+    for (size_t i = 0, count = m_builder.GetSolidsCount(); i < count; ++i)
+    {
+        const MbCube gabarit = m_builder.GetWorldGabarit(i);
+        double priority = 0.0;
+        if (!gabarit.IsEmpty())
+        {
+            MbCartPoint3D center;
+            gabarit.GetCenter(center);
+            const double radius = 0.5 * gabarit.GetDiagonal();
+            priority = radius / (center.DistanceToPoint(eye) + radius + 1.0e-6);
+        }
+        m_tasks.push({ priority, i });
+    }
+
+    if (m_total == 0)
+    {
+        m_isFinished = true;
+        QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+        return;
+    }
+
+    // the workers are std::threads, not OpenMP, so the kernel has to be told
+    m_pParallelRegion.reset(new ParallelRegionGuard());
+    const int threadCount = std::max(1, std::min(QThread::idealThreadCount(), m_total));
+    for (int i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&ProgressiveBuilder::run, this);
+}
+
+void ProgressiveBuilder::cancel()
+{
+    if (m_isCanceled.exchange(true))
+        return;
+    // applyReady reports the end even when no worker posts anything more
+    QMetaObject::invokeMethod(this, "applyReady", Qt::QueuedConnection);
+}
+
+bool ProgressiveBuilder::findInstancePath(const NodeKey& key, int indexBody, ItemPath& path) const
+{
+    return m_builder.FindInstancePath(key, indexBody, path);
+}
+
+std::vector<LodGroup>& ProgressiveBuilder::lodGroups()
+{
+    return m_builder.GetLodGroups();
+}
+
+void ProgressiveBuilder::run()
+{
+    while (!m_isCanceled)
+    {
+        size_t index = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty())
+                return;
+            index = m_tasks.top().second;
+            m_tasks.pop();
+        }
+
+        MeshLevels meshes = m_builder.TessellateSolid(index);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready.push_back({ index, std::move(meshes) });
+        }
+        QMetaObject::invokeMethod(this, "applyReady", Qt::QueuedConnection);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The parallel region ends only after the last worker has returned.
+// ---
+void ProgressiveBuilder::joinWorkers()
+{
+    for (auto& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+    m_pParallelRegion.reset();
+}
+
+//-----------------------------------------------------------------------------
+// Scene segments are only touched here, on the thread of the scene.
+// ---
+void ProgressiveBuilder::applyReady()
+{
+    std::vector<std::pair<size_t, MeshLevels>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ready.swap(m_ready);
+    }
+
+    if (m_isCanceled)
+    {
+        for (auto& mesh : ready)
+            SceneRepresentationBuilder::ReleaseMeshes(mesh.second);
+        if (!m_isFinished)
+        {
+            m_isFinished = true;
+            emit finished();
+        }
+        return;
+    }
+    if (ready.empty())
+        return;
+
+    for (auto& mesh : ready)
+    {
+        m_builder.ApplyMesh(mesh.first, mesh.second);
+        ++m_applied;
+    }
+
+    emit progress(m_applied, m_total);
+    if (m_applied == m_total && !m_isFinished)
+    {
+        // every task is done, the workers are returning
+        joinWorkers();
+        m_isFinished = true;
+        emit finished();
+    }
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <QObject>
+
+#include "cachedscenebuilder.h"
+
+class MbCartPoint3D;
+class ParallelRegionGuard;
+
+// Shows every part of a model as its bounding box at once and swaps the boxes
+// for the real meshes as worker threads finish them. Parts that look largest
+// from the eye point are tessellated first.
+// finished is emitted once, also after cancel; meshes that come in later are dropped.
+class ProgressiveBuilder : public QObject {
+    Q_OBJECT
+public:
+    ProgressiveBuilder(MbModel* pModel, SceneSegment* pTopSegment, const QString& cacheDir, QObject* parent = nullptr);
+    ~ProgressiveBuilder() override;
+
+    void createProxies();
+    void start(const MbCartPoint3D& eye);
+    void cancel();
+    bool findInstancePath(const NodeKey& key, int indexBody, ItemPath& path) const;
+    std::vector<LodGroup>& lodGroups();
+
+signals:
+    void progress(int value, int maximum);
+    void finished();
+
+private slots:
+    void applyReady();
+
+private:
+    void run();
+    void joinWorkers();
+
+private:
+    typedef std::pair<double, size_t> Task;
+
+    MeshCache m_meshCache;
+    CachedSceneBuilder m_builder;
+    std::priority_queue<Task> m_tasks;
+    std::vector<std::pair<size_t, MeshLevels>> m_ready;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<ParallelRegionGuard> m_pParallelRegion; // the kernel is told while the workers run
+    std::mutex m_mutex;
+    std::atomic<bool> m_isCanceled = { false };
+    bool m_isFinished = false;
+    int m_applied = 0;
+    int m_total = 0;
+};
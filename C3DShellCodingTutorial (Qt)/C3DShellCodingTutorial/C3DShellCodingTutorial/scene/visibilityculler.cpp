@@ -0,0 +1,524 @@
+﻿#include <algorithm>
+#include <list>
+
+#include <QRect>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+
+#include "visibilityculler.h"
+
+// Window depth margin so that a part lying on a surface is not hidden by it.
+static const float c_depthBias = 1.0e-4f;
+// Level 0 of the depth pyramid keeps the farthest depth of each 4x4 block.
+static const int c_depthBlock = 4;
+
+VisibilityCuller::VisibilityCuller()
+    : m_depthBuffer(QOpenGLBuffer::PixelPackBuffer)
+{
+}
+
+VisibilityCuller::~VisibilityCuller()
+{
+    delete m_pDepthFbo;
+}
+
+void VisibilityCuller::setEnabled(bool enabled)
+{
+    m_isEnabled = enabled;
+}
+
+bool VisibilityCuller::isEnabled() const
+{
+    return m_isEnabled;
+}
+
+bool VisibilityCuller::needsRefresh() const
+{
+    return m_needsRefresh;
+}
+
+int VisibilityCuller::culledCount() const
+{
+    return m_culledCount;
+}
+
+int VisibilityCuller::generation() const
+{
+    return m_generation;
+}
+
+void VisibilityCuller::reset(RenderContainer& container)
+{
+    for (auto& leaf : m_leaves)
+        setCulled(container, leaf, false);
+    m_culledCount = 0;
+    m_needsRefresh = false;
+}
+
+void VisibilityCuller::setHidden(RenderContainer& container, const NodeKey& key, bool isHidden)
+{
+    if (isHidden)
+        m_hidden.insert(key.GetKey());
+    else
+        m_hidden.erase(key.GetKey());
+
+    for (auto& leaf : m_leaves)
+    {
+        if (leaf.key.GetKey() == key.GetKey())
+        {
+            leaf.isCulled = false;
+            leaf.isVisible = !isHidden;
+        }
+    }
+    container.SetVisibleObject(key, !isHidden);
+    ++m_sceneGeneration;
+    ++m_generation;
+}
+
+void VisibilityCuller::release()
+{
+    delete m_pDepthFbo;
+    m_pDepthFbo = nullptr;
+    m_depthBuffer.destroy();
+    m_depthSize = QSize();
+    m_depthLevels.clear();
+    m_levelSizes.clear();
+    m_isDepthPending = false;
+}
+
+//-----------------------------------------------------------------------------
+// Walks the hierarchy from the root. A node outside the frustum or behind the
+// previous depth hides its whole subtree; a leaf that passes both tests is shown
+// unless it is a level of detail that is not chosen.
+// ---
+void VisibilityCuller::cull(RenderContainer& container, const MbMatrix3D& viewProjection, const LodSelector& lods)
+{
+    m_viewProjection = viewProjection;
+    syncLeaves(container);
+
+    m_culledCount = 0;
+    m_needsRefresh = false;
+    if (!m_isEnabled)
+    {
+        for (auto& leaf : m_leaves)
+            setCulled(container, leaf, lods.isHidden(leaf.key));
+        return;
+    }
+
+    readDepth();
+    // objects without a box are not in the hierarchy
+    for (auto& leaf : m_leaves)
+    {
+        if (leaf.node < 0)
+            setCulled(container, leaf, lods.isHidden(leaf.key));
+    }
+
+    bool isOcclusionCulled = false;
+    std::vector<int> stack;
+    if (!m_nodes.empty())
+        stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = m_nodes[stack.back()];
+        stack.pop_back();
+
+        ScreenRect rect;
+        bool isHidden = project(node.box, m_viewProjection, rect) == Projection::Outside;
+        if (!isHidden && isOccluded(node.box))
+        {
+            isHidden = true;
+            isOcclusionCulled = true;
+        }
+
+        if (isHidden)
+        {
+            for (int i = node.first; i < node.first + node.count; ++i)
+                setCulled(container, m_leaves[m_order[i]], true);
+            m_culledCount += node.count;
+        }
+        else if (node.left < 0)
+        {
+            Leaf& leaf = m_leaves[m_order[node.first]];
+            setCulled(container, leaf, lods.isHidden(leaf.key));
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+    m_needsRefresh = isOcclusionCulled &&
+        (!(m_depthViewProjection == m_viewProjection) || m_depthSceneGeneration != m_sceneGeneration);
+}
+
+//-----------------------------------------------------------------------------
+// Copies the depth of the frame just drawn into a pixel buffer. The copy runs
+// asynchronously and is mapped at the next cull, so the frame does not wait on it.
+// ---
+void VisibilityCuller::captureDepth(QOpenGLContext* pContext, const QSize& size)
+{
+    if (!m_isEnabled || pContext == nullptr || size.isEmpty())
+        return;
+    // OpenGL ES cannot read back depth
+    m_isOcclusionSupported = !pContext->isOpenGLES();
+    if (!m_isOcclusionSupported)
+        return;
+
+    if (m_pDepthFbo == nullptr || m_pDepthFbo->size() != size)
+    {
+        delete m_pDepthFbo;
+        // the same attachment as QOpenGLWidget, the blit needs matching depth formats
+        m_pDepthFbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil);
+    }
+
+    const QRect rect(QPoint(0, 0), size);
+    QOpenGLFramebufferObject::blitFramebuffer(m_pDepthFbo, rect, nullptr, rect, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    if (!m_depthBuffer.isCreated())
+        m_depthBuffer.create();
+    m_depthBuffer.bind();
+    if (m_depthSize != size)
+    {
+        m_depthBuffer.allocate(size.width() * size.height() * int(sizeof(float)));
+        m_depthSize = size;
+    }
+
+    QOpenGLFunctions* pFunctions = pContext->functions();
+    m_pDepthFbo->bind();
+    pFunctions->glReadPixels(0, 0, size.width(), size.height(), GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    m_depthBuffer.release();
+    pFunctions->glBindFramebuffer(GL_FRAMEBUFFER, pContext->defaultFramebufferObject());
+
+    m_pendingViewProjection = m_viewProjection;
+    m_pendingSceneGeneration = m_sceneGeneration;
+    m_isDepthPending = true;
+}
+
+void VisibilityCuller::readDepth()
+{
+    if (!m_isDepthPending)
+        return;
+    m_isDepthPending = false;
+
+    m_depthBuffer.bind();
+    if (const float* pDepth = static_cast<const float*>(m_depthBuffer.map(QOpenGLBuffer::ReadOnly)))
+    {
+        buildDepthLevels(pDepth);
+        m_depthBuffer.unmap();
+        m_depthViewProjection = m_pendingViewProjection;
+        m_depthSceneGeneration = m_pendingSceneGeneration;
+    }
+    m_depthBuffer.release();
+}
+
+void VisibilityCuller::buildDepthLevels(const float* pDepth)
+{
+    int width = (m_depthSize.width() + c_depthBlock - 1) / c_depthBlock;
+    int height = (m_depthSize.height() + c_depthBlock - 1) / c_depthBlock;
+
+    m_depthLevels.resize(1);
+    m_levelSizes.assign(1, QSize(width, height));
+    std::vector<float>& level0 = m_depthLevels[0];
+    level0.assign(size_t(width) * height, 0.0f);
+    for (int y = 0; y < m_depthSize.height(); ++y)
+    {
+        const float* pRow = pDepth + size_t(y) * m_depthSize.width();
+        float* pBlocks = level0.data() + size_t(y / c_depthBlock) * width;
+        for (int x = 0; x < m_depthSize.width(); ++x)
+        {
+            float& block = pBlocks[x / c_depthBlock];
+            block = std::max(block, pRow[x]);
+        }
+    }
+
+    while (width > 1 || height > 1)
+    {
+        const std::vector<float>& fine = m_depthLevels.back();
+        const int fineWidth = width;
+        const int fineHeight = height;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+
+        std::vector<float> coarse(size_t(width) * height);
+        for (int y = 0; y < height; ++y)
+        {
+            const int y0 = 2 * y, y1 = std::min(2 * y + 1, fineHeight - 1);
+            for (int x = 0; x < width; ++x)
+            {
+                const int x0 = 2 * x, x1 = std::min(2 * x + 1, fineWidth - 1);
+                coarse[size_t(y) * width + x] = std::max(
+                    std::max(fine[size_t(y0) * fineWidth + x0], fine[size_t(y0) * fineWidth + x1]),
+                    std::max(fine[size_t(y1) * fineWidth + x0], fine[size_t(y1) * fineWidth + x1]));
+            }
+        }
+        m_depthLevels.push_back(std::move(coarse));
+        m_levelSizes.push_back(QSize(width, height));
+    }
+}
+
+float VisibilityCuller::maxDepth(size_t level, int x0, int y0, int x1, int y1) const
+{
+    const std::vector<float>& depth = m_depthLevels[level];
+    const int width = m_levelSizes[level].width();
+    float result = 0.0f;
+    for (int y = y0; y <= y1; ++y)
+        for (int x = x0; x <= x1; ++x)
+            result = std::max(result, depth[size_t(y) * width + x]);
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+// The box is tested against the depth with the camera that depth was drawn
+// with. The pyramid level is picked so that the box covers at most 3x3 texels.
+// ---
+bool VisibilityCuller::isOccluded(const MbCube& box) const
+{
+    if (!m_isOcclusionSupported || m_depthLevels.empty())
+        return false;
+
+    ScreenRect rect;
+    if (project(box, m_depthViewProjection, rect) != Projection::Inside)
+        return false;
+
+    const QSize& size0 = m_levelSizes[0];
+    int x0 = std::max(0, int((rect.x0 * 0.5 + 0.5) * size0.width()));
+    int y0 = std::max(0, int((rect.y0 * 0.5 + 0.5) * size0.height()));
+    int x1 = std::min(size0.width() - 1, int((rect.x1 * 0.5 + 0.5) * size0.width()));
+    int y1 = std::min(size0.height() - 1, int((rect.y1 * 0.5 + 0.5) * size0.height()));
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    size_t level = 0;
+    while (level + 1 < m_depthLevels.size() && std::max(x1 - x0, y1 - y0) > 2)
+    {
+        x0 /= 2; y0 /= 2; x1 /= 2; y1 /= 2;
+        ++level;
+    }
+    return rect.depth > maxDepth(level, x0, y0, x1, y1) + c_depthBias;
+}
+
+//-----------------------------------------------------------------------------
+// Row vector convention of MbMatrix3D: clip = (x, y, z, 1) * matrix.
+// ---
+VisibilityCuller::Projection VisibilityCuller::project(const MbCube& box, const MbMatrix3D& matrix, ScreenRect& rect)
+{
+    if (box.IsEmpty())
+        return Projection::Crossing;
+
+    unsigned outsideAll = 0x3f;
+    bool isCrossing = false;
+    rect = { 1.0, 1.0, -1.0, -1.0, 1.0 };
+    for (int i = 0; i < 8; ++i)
+    {
+        const double x = (i & 1) ? box.pmax.x : box.pmin.x;
+        const double y = (i & 2) ? box.pmax.y : box.pmin.y;
+        const double z = (i & 4) ? box.pmax.z : box.pmin.z;
+        double clip[4];
+        for (size_t j = 0; j < 4; ++j)
+            clip[j] = x * matrix.El(0, j) + y * matrix.El(1, j) + z * matrix.El(2, j) + matrix.El(3, j);
+
+        const double w = clip[3];
+        unsigned outside = 0;
+        if (clip[0] < -w) outside |= 0x01;
+        if (clip[0] > w)  outside |= 0x02;
+        if (clip[1] < -w) outside |= 0x04;
+        if (clip[1] > w)  outside |= 0x08;
+        if (clip[2] < -w) outside |= 0x10;
+        if (clip[2] > w)  outside |= 0x20;
+        outsideAll &= outside;
+
+        if (w <= 1.0e-9)
+        {
+            isCrossing = true;
+            continue;
+        }
+        const double nx = clip[0] / w, ny = clip[1] / w, nz = clip[2] / w;
+        rect.x0 = std::min(rect.x0, nx);
+        rect.y0 = std::min(rect.y0, ny);
+        rect.x1 = std::max(rect.x1, nx);
+        rect.y1 = std::max(rect.y1, ny);
+        rect.depth = std::min(rect.depth, nz * 0.5 + 0.5);
+    }
+    if (outsideAll != 0)
+        return Projection::Outside;
+    return isCrossing ? Projection::Crossing : Projection::Inside;
+}
+
+MbCube VisibilityCuller::objectBox(RenderObject* pObject)
+{
+    if (!pObject->IsBoundingBoxValid())
+        return MbCube();
+    MbCube box = pObject->GetBoundingBox();
+    if (!box.IsEmpty())
+        box.Transform(pObject->GetMatrix());
+    return box;
+}
+
+void VisibilityCuller::setCulled(RenderContainer& container, Leaf& leaf, bool isCulled)
+{
+    if (leaf.isCulled == isCulled)
+        return;
+    // an object hidden by someone else stays hidden, also when it was culled before
+    if ((isCulled && !leaf.pObject->IsVisible()) || m_hidden.count(leaf.key.GetKey()) != 0)
+    {
+        leaf.isCulled = false;
+        return;
+    }
+    leaf.isCulled = isCulled;
+    leaf.isVisible = !isCulled;
+    container.SetVisibleObject(leaf.key, !isCulled);
+    ++m_generation;
+}
+
+//-----------------------------------------------------------------------------
+// Same objects as last time: refit the boxes that changed. Objects added,
+// removed or with a box that appeared or vanished: rebuild.
+// ---
+void VisibilityCuller::syncLeaves(RenderContainer& container)
+{
+    const std::list<RenderObject*> objects = container.GetObjects();
+    bool isRebuild = objects.size() != m_leaves.size();
+    if (!isRebuild)
+    {
+        size_t i = 0;
+        for (RenderObject* pObject : objects)
+        {
+            const Leaf& leaf = m_leaves[i++];
+            if (leaf.pObject != pObject || leaf.key != pObject->GetUniqueKey())
+            {
+                isRebuild = true;
+                break;
+            }
+        }
+    }
+
+    if (!isRebuild)
+    {
+        for (auto& leaf : m_leaves)
+        {
+            // shown or hidden by someone else; a culled object shown again is not culled any more
+            const bool isVisible = leaf.pObject->IsVisible();
+            if (isVisible != leaf.isVisible)
+            {
+                leaf.isVisible = isVisible;
+                leaf.isCulled = leaf.isCulled && !isVisible;
+                ++m_sceneGeneration;
+            }
+
+            const MbCube box = objectBox(leaf.pObject);
+            if (box == leaf.box)
+                continue;
+            if (box.IsEmpty() != leaf.box.IsEmpty())
+            {
+                isRebuild = true;
+                break;
+            }
+            leaf.box = box;
+            m_nodes[leaf.node].box = box;
+            refit(m_nodes[leaf.node].parent);
+            ++m_sceneGeneration;
+            ++m_generation;
+        }
+    }
+
+    if (isRebuild)
+    {
+        reset(container);
+        m_leaves.clear();
+        m_leaves.reserve(objects.size());
+        for (RenderObject* pObject : objects)
+        {
+            Leaf leaf;
+            leaf.pObject = pObject;
+            leaf.key = pObject->GetUniqueKey();
+            leaf.box = objectBox(pObject);
+            leaf.isVisible = pObject->IsVisible();
+            m_leaves.push_back(leaf);
+        }
+        build();
+        ++m_sceneGeneration;
+        ++m_generation;
+    }
+}
+
+void VisibilityCuller::build()
+{
+    m_nodes.clear();
+    m_order.clear();
+    // objects without a box yet are never culled
+    for (int i = 0; i < int(m_leaves.size()); ++i)
+    {
+        if (!m_leaves[i].box.IsEmpty())
+            m_order.push_back(i);
+    }
+    if (m_order.empty())
+        return;
+    m_nodes.reserve(2 * m_order.size());
+    buildNode(-1, 0, int(m_order.size()));
+}
+
+//-----------------------------------------------------------------------------
+// Top-down split at the median of the box centers along the longest axis.
+// ---
+int VisibilityCuller::buildNode(int parent, int first, int count)
+{
+    const int index = int(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodes[index].parent = parent;
+    m_nodes[index].first = first;
+    m_nodes[index].count = count;
+
+    MbCube box, centers;
+    for (int i = first; i < first + count; ++i)
+    {
+        const MbCube& leafBox = m_leaves[m_order[i]].box;
+        MbCartPoint3D center;
+        leafBox.GetCenter(center);
+        box |= leafBox;
+        centers |= center;
+    }
+    m_nodes[index].box = box;
+
+    if (count == 1)
+    {
+        m_leaves[m_order[first]].node = index;
+        return index;
+    }
+
+    const double dx = centers.pmax.x - centers.pmin.x;
+    const double dy = centers.pmax.y - centers.pmin.y;
+    const double dz = centers.pmax.z - centers.pmin.z;
+    const int axis = (dx >= dy && dx >= dz) ? 0 : (dy >= dz ? 1 : 2);
+    auto centerOf = [this, axis](int leafIndex)
+    {
+        const MbCube& leafBox = m_leaves[leafIndex].box;
+        return axis == 0 ? leafBox.pmin.x + leafBox.pmax.x
+             : axis == 1 ? leafBox.pmin.y + leafBox.pmax.y
+                         : leafBox.pmin.z + leafBox.pmax.z;
+    };
+
+    const int half = count / 2;
+    std::nth_element(m_order.begin() + first, m_order.begin() + first + half, m_order.begin() + first + count,
+        [&centerOf](int a, int b) { return centerOf(a) < centerOf(b); });
+
+    const int left = buildNode(index, first, half);
+    const int right = buildNode(index, first + half, count - half);
+    m_nodes[index].left = left;
+    m_nodes[index].right = right;
+    return index;
+}
+
+void VisibilityCuller::refit(int node)
+{
+    while (node >= 0)
+    {
+        Node& current = m_nodes[node];
+        MbCube box = m_nodes[current.left].box;
+        box |= m_nodes[current.right].box;
+        if (box == current.box)
+            break;
+        current.box = box;
+        node = current.parent;
+    }
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+#include <unordered_set>
+#include <vector>
+
+#include <QSize>
+#include <QOpenGLBuffer>
+
+#include <mb_cube.h>
+#include <mb_matrix3d.h>
+#include <vsn_rendercontainer.h>
+#include <vsn_renderobject.h>
+
+#include "lodselector.h"
+
+VSN_USE_NAMESPACE
+
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// Hides the render objects that are outside the view frustum or behind the
+// depth buffer of the previous frame, so only what can be seen is drawn.
+// A bounding volume hierarchy over the object boxes lets a whole group of
+// objects be rejected with one test; it is refit when objects move and
+// rebuilt only when objects are added or removed.
+// The levels of detail LodSelector did not choose are hidden here as well, so
+// the visibility of the objects has a single owner.
+class VisibilityCuller
+{
+public:
+    VisibilityCuller();
+    ~VisibilityCuller();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    // Both need the OpenGL context current. When disabled, cull only applies the levels of detail.
+    void cull(RenderContainer& container, const MbMatrix3D& viewProjection, const LodSelector& lods);
+    void captureDepth(QOpenGLContext* pContext, const QSize& size);
+
+    // Shows again everything hidden by culling, e.g. before a zoom to fit.
+    void reset(RenderContainer& container);
+    // Hides or shows an object for good; culling never shows it while hidden.
+    // Objects hidden while they may be culled must go through here.
+    void setHidden(RenderContainer& container, const NodeKey& key, bool isHidden);
+    // Frees the OpenGL resources; needs the context current.
+    void release();
+
+    // The last cull used depth from another camera position; one more frame
+    // brings back objects that came into view since.
+    bool needsRefresh() const;
+    int culledCount() const;
+    // Changes whenever an object was shown, hidden, moved, added or removed.
+    int generation() const;
+
+private:
+    struct Node
+    {
+        MbCube box;
+        int parent = -1;
+        int left = -1;
+        int right = -1;
+        int first = 0; // range in m_order
+        int count = 0;
+    };
+
+    struct Leaf
+    {
+        RenderObject* pObject = nullptr;
+        NodeKey key;
+        MbCube box;
+        int node = -1;
+        bool isCulled = false;
+        bool isVisible = true; // as last seen, to notice changes made by others
+    };
+
+    enum class Projection { Outside, Crossing, Inside };
+
+    struct ScreenRect
+    {
+        double x0, y0, x1, y1; // normalized device coordinates
+        double depth;          // nearest window depth
+    };
+
+    void syncLeaves(RenderContainer& container);
+    void build();
+    int buildNode(int parent, int first, int count);
+    void refit(int node);
+    void setCulled(RenderContainer& container, Leaf& leaf, bool isCulled);
+    bool isOccluded(const MbCube& box) const;
+    void readDepth();
+    void buildDepthLevels(const float* pDepth);
+    float maxDepth(size_t level, int x0, int y0, int x1, int y1) const;
+
+    static MbCube objectBox(RenderObject* pObject);
+    static Projection project(const MbCube& box, const MbMatrix3D& matrix, ScreenRect& rect);
+
+private:
+    std::vector<Node> m_nodes;
+    std::vector<Leaf> m_leaves;
+    std::vector<int> m_order; // leaf indices, each node owns a contiguous range
+
+    std::vector<std::vector<float>> m_depthLevels; // max depth pyramid, level 0 is 1/4 of the frame
+    std::vector<QSize> m_levelSizes;
+    MbMatrix3D m_depthViewProjection;
+    MbMatrix3D m_pendingViewProjection;
+    MbMatrix3D m_viewProjection;
+    // objects added, removed, moved, shown or hidden; the depth is stale when it differs
+    int m_sceneGeneration = 0;
+    int m_depthSceneGeneration = 0;
+    int m_pendingSceneGeneration = 0;
+    std::unordered_set<uint64> m_hidden; // by setHidden
+
+    QOpenGLFramebufferObject* m_pDepthFbo = nullptr;
+    QOpenGLBuffer m_depthBuffer;
+    QSize m_depthSize;
+    bool m_isDepthPending = false;
+    bool m_isOcclusionSupported = true;
+
+    bool m_isEnabled = true;
+    bool m_needsRefresh = false;
+    int m_culledCount = 0;
+    int m_generation = 0;
+};
@@ -12,6 +12,12 @@
 #include <QContextMenuEvent>
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QThread>
+#include <QProgressDialog>
+#include <QCryptographicHash>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 
 #include <plane_instance.h>
 #include <op_swept_parameter.h>
@@ -32,6 +38,10 @@
 #include "visionscene.h"
 #include "globaldef.h"
 #include "storagelocation.h"
+#include "cachedscenebuilder.h"
+#include "modelloader.h"
+#include "progressivebuilder.h"
+#include "buildprofiler.h"
 
 
 
@@ -71,14 +81,22 @@ VisionScene::VisionScene(QWidget* pParent)
     QtVision::CreateProcessesCameraControls(graphicsEngine()->GetTopEssence());
 
     //Object::Connect(graphicsEngine()->GetObjectPickSelection(), &ObjectPickSelection::ObjectHoverMove, this, &VisionScene::slotObjectHoverMove);
-    graphicsEngine()->GetObjectPickSelection()->SetHoverEnabled(true);
+    // hover is picked from m_pickBuffer, Vision only picks on click
+    graphicsEngine()->GetObjectPickSelection()->SetHoverEnabled(false);
     m_box = RenderObject(*m_pBoxRep);
 }
 
 
 VisionScene::~VisionScene()
 {
+    if (m_pModelLoader != nullptr)
+        m_pModelLoader->cancel();
+    releaseLoader();
+    VSN_DELETE_AND_NULL(m_pPendingSegment);
     releaseRootSegment();
+    makeCurrent();
+    m_culler.release();
+    m_pickBuffer.release();
     VSN_DELETE_AND_NULL(m_pBoxRep);
 }
 
@@ -101,9 +119,54 @@ bool VisionScene::event(QEvent* event)
 
 
 
+//-----------------------------------------------------------------------------
+// The levels of detail are chosen for this camera before culling. Hidden parts
+// are culled with the depth of the previous frame, so the depth of this one is
+// read back after drawing.
+// ---
 void VisionScene::paintGL()
 {
+    if (context() != nullptr)
+    {
+        makeCurrent();
+        const MbMatrix3D viewProjection = viewport()->GetMultipleMatrix();
+        const MbMatrix3D projection = viewport()->GetProjectionMatrix();
+        int width = 0, height = 0;
+        viewport()->GetViewportSize(width, height);
+        for (ProgressiveBuilder* pBuilder : m_progressiveBuilders)
+            m_lodSelector.select(pBuilder->lodGroups(), viewProjection, projection, height);
+        m_culler.cull(*sceneContent()->GetContainer(), viewProjection, m_lodSelector);
+        // the ID buffer shows only what is drawn, so it follows the culling
+        if (m_culler.generation() != m_pickGeneration)
+        {
+            m_pickGeneration = m_culler.generation();
+            m_pickBuffer.invalidate();
+        }
+    }
+
     QtOpenGLSceneWidget::paintGL();
+
+    if (m_hover.type != ObjectType::None && context() != nullptr)
+    {
+        makeCurrent();
+        m_pickBuffer.drawHighlight(context(), viewport()->GetMultipleMatrix(), m_hover, m_ptrSelectManager->GetHighlightColor());
+    }
+
+    if (m_culler.isEnabled() && context() != nullptr)
+    {
+        makeCurrent();
+        m_culler.captureDepth(context(), size() * devicePixelRatio());
+        if (m_culler.needsRefresh())
+            requestFrame();
+    }
+
+    // the frame counts once the GPU has drawn it, not when it was queued
+    if (PROFILER.isOpen("First frame") && context() != nullptr)
+    {
+        makeCurrent();
+        context()->functions()->glFinish();
+        PROFILER.end("First frame");
+    }
 }
 
 void VisionScene::setGradientImage() {
@@ -137,7 +200,7 @@ void VisionScene::initializeGL()
     m_ptrSelectManager->SetSelectionMode(SelectionManager::MultiSelection);
     m_ptrSelectManager->SetDynamicHighlighting(true);
 
-    Object::Connect(m_ptrSelectManager.get(), &SelectionManager::signalStateModified, this, &QtOpenGLWidget::updateWidget);
+    Object::Connect(m_ptrSelectManager.get(), &SelectionManager::signalStateModified, this, &QtOpenGLWidget::requestFrame);
     Object::Connect(m_ptrSelectManager.get(), &SelectionManager::signalItemSelectModified, this, &VisionScene::signalItemSelectModified);
     Object::Connect(m_ptrSelectManager.get(), &SelectionManager::signalItemsSelectModified, this, &VisionScene::signalItemSelectModified);
 
@@ -162,6 +225,9 @@ void VisionScene::initializeGL()
 
 void VisionScene::setFilter(bool bodyEnable)
 {
+    m_pickBuffer.setBodyPicking(bodyEnable);
+    m_hover = PickBuffer::Hit();
+
     if (!bodyEnable) {
         m_ptrSelectManager->SetBodySelectionEnabled(false);
 
@@ -185,6 +251,7 @@ void VisionScene::setFilter(bool bodyEnable)
 
 void VisionScene::releaseRootSegment()
 {
+    stopBuild(m_pProgressBuild);
 
     //if (!m_sceneSegments.empty())
     //{
@@ -210,6 +277,19 @@ void VisionScene::releaseRootSegment()
     //    m_sceneSolidSegments.clear();
     //}
 
+    // the builders reference segments that are deleted below
+    qDeleteAll(m_progressiveBuilders);
+    m_progressiveBuilders.clear();
+    if (m_pLoadBuilder != nullptr)
+    {
+        m_pLoadBuilder = nullptr;
+        finishLoading();
+    }
+    m_lodSelector.clear();
+    m_hover = PickBuffer::Hit();
+    m_pickBuffer.invalidate();
+    m_objectIndex.clear();
+
     std::list<SceneSegment*> seg = ObjectsSegment->GetSegments();
     for (auto& segment : seg) {
         if (segment != nullptr) {
@@ -228,15 +308,15 @@ void VisionScene::releaseRootSegment()
     //    }
     //    m_sceneLoadedSegments.clear();
     //}
-    if (!m_MbModels.empty()) {
-        for (auto& model : m_MbModels)
-        {
-            if (model != nullptr) {
-                ::DeleteItem(model);
-            }
-
-        }
-    }
+    // the models were AddRef'd when they were loaded
+    for (auto& model : m_MbModels)
+        ::ReleaseItem(model);
+    m_MbModels.clear();
+    // the segments went away with ObjectsSegment children above
+    m_sceneLoadedSegments.clear();
+    for (auto& object : m_drawnObjects)
+        ::ReleaseItem(object.m_item);
+    m_drawnObjects.clear();
 }
 //-----------------------------------------------------------------------------
 // 
@@ -268,56 +348,152 @@ void VisionScene::createScene()
 // ---
 
 
-void asd(int* k) {
+//-----------------------------------------------------------------------------
+// An open single-face solid carrying a solid in its geometric attribute is
+// drawn through that solid.
+// ---
+static const MbItem* meshSource(const MbItem* item)
+{
+    if (item != nullptr && item->Family() == st_Solid) {
+        const MbSolid& solid = static_cast<const MbSolid&>(*item);
+        if (!solid.IsClosed() && (solid.GetFacesCount() == 1)) {
+            AttrVector attrs;
+            solid.GetAttributes(attrs, at_GeomAttribute); // Выдать атрибуты заданного типа. Get attributes of a given type. 
+            if (attrs.size() == 1 && (attrs[0]->AttributeType() == at_GeomAttribute)) {
+                const MbGeomAttribute* attr = (const MbGeomAttribute*)attrs[0];
+                const MbSpaceItem* spaceItem = attr->GetSpaceItem();
+                if (spaceItem != NULL && spaceItem->IsA() == st_Solid)
+                    return static_cast<const MbSolid*>(spaceItem);
+            }
+        }
+    }
+    return item;
+}
+
+//-----------------------------------------------------------------------------
+// Geometry and style of a model; equal models give equal fingerprints across runs.
+// Empty when the item cannot be serialized, such a model matches nothing.
+// ---
+QByteArray VisionScene::modelFingerprint(const Model& model)
+{
+    const QByteArray data = MeshCache::itemData(model.item);
+    if (data.isEmpty())
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(data);
+
+    const quint32 style[3] = { model.style.getColor(), quint32(model.style.getWidth()), quint32(model.style.getStyle()) };
+    hash.addData(reinterpret_cast<const char*>(style), sizeof(style));
+    return hash.result();
+}
+
+void VisionScene::releaseDrawnObject(DrawnObject& object)
+{
+    if (object.m_segment != nullptr)
+    {
+        removeObject(object.m_segment);
+        ObjectsSegment->RemoveSegment(object.m_segment);
+        VSN_DELETE_AND_NULL(object.m_segment);
+    }
+    ::ReleaseItem(object.m_item);
+}
+
+//-----------------------------------------------------------------------------
+// The index is kept in step with the children of ObjectsSegment, so selection
+// handlers find a segment by its key instead of walking the scene.
+// ---
+void VisionScene::addObject(SceneSegment* pSegment, const QString& typeFamily)
+{
+    SceneObjectInfo& info = m_objectIndex[pSegment->GetUniqueKey().GetKey()];
+    info.m_segment = pSegment;
+    info.m_typeFamily = typeFamily;
+}
 
+void VisionScene::removeObject(SceneSegment* pSegment)
+{
+    m_objectIndex.remove(pSegment->GetUniqueKey().GetKey());
 }
 
+const SceneObjectInfo* VisionScene::objectInfo(const NodeKey& key) const
+{
+    auto it = m_objectIndex.constFind(key.GetKey());
+    return it != m_objectIndex.constEnd() ? &it.value() : nullptr;
+}
 
+//-----------------------------------------------------------------------------
+// Models are matched with the previous run by fingerprint: unchanged ones keep
+// their segments and buffers, the rest are removed or built anew. New items are
+// tessellated once by their MathGeometry on the Vision build thread.
+// ---
 void VisionScene::drawObjects(const QVector<Model>& models)
 {
-    int a = 10;
-    int* b = &a;
-    asd(b);
+    // the previous build may still be writing to segments released below;
+    // what it left half done is not reused
+    if (stopBuild(m_pProgressBuild))
+    {
+        for (auto& object : m_drawnObjects)
+            releaseDrawnObject(object);
+        m_drawnObjects.clear();
+    }
+
+    QHash<QByteArray, DrawnObject> drawnObjects;
+    QVector<QPair<QByteArray, const Model*>> addedModels;
+    QHash<QByteArray, int> occurrences;
+
     for (auto &model : models) {
-        //auto ref = model.item->RefType();
-        NodeKey key = NodeKey::GenerationKey();
-
-        
-        MbItem* item = model.item;
-        Style style = model.style;
-        /*item->SetColor(style.getColor);
-        item->SetWidth(style.getWidth);
-        item->SetStyle(style.getStyle);*/
-        MbItem* drawItem = nullptr;
-        if (item->Family() == st_Solid) { 
-            MbSolid& solid = static_cast<MbSolid&>(*item);
-            if (!solid.IsClosed() && (solid.GetFacesCount() == 1)) {
-                AttrVector attrs;
-                solid.GetAttributes(attrs, at_GeomAttribute); // Выдать атрибуты заданного типа. Get attributes of a given type. 
-                if (attrs.size() == 1 && (attrs[0]->AttributeType() == at_GeomAttribute)) {
-                    MbGeomAttribute* attr = (MbGeomAttribute*)attrs[0];
-                    if (attr != nullptr) {
-                        const MbSpaceItem* spaceItem = attr->GetSpaceItem();
-                        if (spaceItem != NULL && spaceItem->IsA() == st_Solid) {
-                            drawItem = ((MbSolid*)spaceItem)->CreateMesh(MbStepData(ist_SpaceStep, Math::visualSag), MbFormNote(), nullptr);
-                        }
-                    }
-                }
-            }
+        if (model.item == nullptr)
+            continue;
+
+        // identical models in one run are told apart by their occurrence
+        QByteArray key = modelFingerprint(model);
+        if (key.isEmpty())
+        {
+            // shorter than any fingerprint, so no later run finds it
+            addedModels.push_back({ QByteArray("?") + QByteArray::number(addedModels.size()), &model });
+            continue;
         }
+        key.append(QByteArray::number(occurrences[key]++));
 
-        if (drawItem == nullptr)
-            drawItem = item->CreateMesh(MbStepData(ist_SpaceStep, Math::visualSag), MbFormNote(), nullptr);
-
-        if (drawItem != nullptr) {
-            //drawModel.AddItem(*drawItem, geomItem.GetItemName()); // Добавить объект 
-            MbMesh* pMesh = new MbMesh;
-            AddRefItem(pMesh);
-            drawItem->CalculateMesh(MbStepData(ist_SpaceStep, Math::visualSag), MbFormNote(), *pMesh);
-            auto mathRep = SceneGenerator::Instance()->CreateMathRep(pMesh, ObjectsSegment, MathGeometry::Synchronous);
-            auto segment = new SceneSegment(mathRep, key, ObjectsSegment);
-            segment->AddFeature(new Features::DoubleSidedLighting());
+        auto it = m_drawnObjects.find(key);
+        if (it != m_drawnObjects.end())
+        {
+            drawnObjects.insert(key, it.value());
+            m_drawnObjects.erase(it);
         }
+        else
+            addedModels.push_back({ key, &model });
+    }
+
+    for (auto& object : m_drawnObjects)
+        releaseDrawnObject(object);
+    m_drawnObjects = drawnObjects;
+
+    if (addedModels.empty())
+    {
+        PROFILER.begin("First frame");
+        update();
+        return;
+    }
+
+    PROFILER.begin("Tessellation");
+    m_pProgressBuild = SceneGenerator::Instance()->CreateProgressBuild();
+    Object::Connect(m_pProgressBuild, &ProgressBuild::ValueModified, this, &VisionScene::slotBuildProgress);
+    Object::Connect(m_pProgressBuild, &ProgressBuild::BuildAllCompleted, this, &VisionScene::slotFinishBuildRep);
+
+    for (auto& added : addedModels) {
+        const Model& model = *added.second;
+        const MbItem* drawItem = meshSource(model.item);
+
+        auto mathRep = SceneGenerator::Instance()->CreateMathRep(drawItem, ObjectsSegment, MathGeometry::Threaded);
+        auto segment = new SceneSegment(mathRep, NodeKey::GenerationKey(), ObjectsSegment);
+        segment->AddFeature(new Features::DoubleSidedLighting());
+        const uint32_t color = model.style.getColor();
+        segment->SetColorPresentationMaterial(Color(getR(color), getG(color), getB(color)));
+        addObject(segment, m_mapSpaceTypeToString.value(model.item->IsA()));
+
+        ::AddRefItem(drawItem);
+        m_drawnObjects.insert(added.first, { segment, drawItem });
     }
     /*
     releaseRootSegment();
@@ -475,39 +651,254 @@ void VisionScene::timerEvent(QTimerEvent*)
     update();
 }
 
+//-----------------------------------------------------------------------------
+// The file is read and built by a ModelLoader on its own thread; the segments
+// are attached only when the whole model is ready.
+// ---
 void VisionScene::openFile(bool state)
 {
     Q_ASSERT(ObjectsSegment != nullptr);
 
+    if (isLoading())
+        return;
+
     QString fileName = QFileDialog::getOpenFileName(this, tr("Open models"), APP.modelsDir(), ("*.c3d"));
 
     if (!fileName.isEmpty())
     {
         if (state) releaseRootSegment();
-        QFile file(fileName);
-        if (!file.open(QFile::ReadOnly))
-            return;
 
-        QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-        QByteArray data = file.readAll();
-        if (auto m_pModel = SceneGenerator::Instance()->LoadModel(data.constData(), data.length()))
+        m_isLoadCanceled = false;
+        m_pLoadProgress = new QProgressDialog(tr("Opening %1").arg(QFileInfo(fileName).fileName()), tr("Cancel"), 0, 0, this);
+        m_pLoadProgress->setWindowModality(Qt::WindowModal);
+        m_pLoadProgress->setMinimumDuration(500);
+        connect(m_pLoadProgress, &QProgressDialog::canceled, this, &VisionScene::cancelLoading);
+
+        m_pLoaderThread = new QThread;
+        m_pModelLoader = new ModelLoader(fileName);
+        m_pModelLoader->moveToThread(m_pLoaderThread);
+
+        connect(m_pLoaderThread, &QThread::started, m_pModelLoader, &ModelLoader::process);
+        connect(m_pModelLoader, &ModelLoader::progress, m_pLoadProgress, &QProgressDialog::setLabelText);
+        connect(m_pModelLoader, &ModelLoader::finished, m_pLoaderThread, &QThread::quit);
+        connect(m_pModelLoader, &ModelLoader::finished, this, &VisionScene::slotModelLoaded);
+
+        m_pLoaderThread->start();
+    }
+}
+
+bool VisionScene::isLoading() const
+{
+    return m_pModelLoader != nullptr || m_pPendingSegment != nullptr || m_pLoadBuilder != nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// A canceled progressive build keeps the parts it has made so far; the rest
+// stay bounding boxes.
+// ---
+void VisionScene::cancelLoading()
+{
+    m_isLoadCanceled = true;
+    if (m_pModelLoader != nullptr)
+        m_pModelLoader->cancel();
+    if (m_pLoadBuild != nullptr)
+        m_pLoadBuild->CancelBuild();
+    if (m_pLoadBuilder != nullptr)
+        m_pLoadBuilder->cancel();
+}
+
+//-----------------------------------------------------------------------------
+// Also drops a SceneGenerator segment that has not been applied yet: its build
+// is stopped and disconnected first so BuildAllCompleted cannot reach it.
+// ---
+void VisionScene::releaseLoader()
+{
+    if (m_pLoaderThread != nullptr)
+    {
+        m_pLoaderThread->quit();
+        m_pLoaderThread->wait();
+    }
+    delete m_pModelLoader;
+    m_pModelLoader = nullptr;
+    delete m_pLoaderThread;
+    m_pLoaderThread = nullptr;
+
+    stopBuild(m_pLoadBuild);
+    VSN_DELETE_AND_NULL(m_pPendingSegment);
+}
+
+//-----------------------------------------------------------------------------
+// The threaded build writes to its segments until IsRunning turns false; only
+// then may they be deleted. Its signals no longer reach the scene. True when
+// the build had not finished.
+// ---
+bool VisionScene::stopBuild(ProgressBuild*& pBuild)
+{
+    if (pBuild == nullptr)
+        return false;
+    pBuild->Disconnect(this);
+    const bool isRunning = pBuild->IsRunning();
+    pBuild->CancelBuild();
+    while (pBuild->IsRunning())
+        QThread::msleep(1);
+    pBuild = nullptr;
+    return isRunning;
+}
+
+void VisionScene::finishLoading()
+{
+    if (m_pLoadProgress != nullptr)
+    {
+        m_pLoadProgress->deleteLater();
+        m_pLoadProgress = nullptr;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// A model the scene builder does not support is handed to SceneGenerator,
+// whose segment waits for ProgressBuild::BuildAllCompleted.
+// ---
+void VisionScene::slotModelLoaded()
+{
+    const QString fileName = QFileInfo(m_pModelLoader->fileName()).fileName();
+    MbModel* pModel = m_pModelLoader->takeModel();
+    releaseLoader();
+
+    if (pModel == nullptr)
+    {
+        finishLoading();
+        if (!m_isLoadCanceled)
+            emit sendToSceneMessage(tr("Failed to open %1").arg(fileName), ResultType::Error);
+        return;
+    }
+
+    ::AddRefItem(pModel);
+    m_MbModels.push_back(pModel);
+
+    if (SceneRepresentationBuilder::IsSupported(pModel))
+    {
+        // boxes first, the parts come in as they are tessellated
+        auto segment = new SceneSegment();
+        ObjectsSegment->AddSegment(segment);
+        m_sceneLoadedSegments.push_back(segment);
+        addObject(segment);
+
+        auto builder = new ProgressiveBuilder(pModel, segment, APP.meshCacheDir(), this);
+        m_progressiveBuilders.push_back(builder);
+        m_pLoadBuilder = builder;
+        connect(builder, &ProgressiveBuilder::progress, this, [this, builder](int value, int maximum)
         {
-            Q_ASSERT(ObjectsSegment != nullptr);
-            ProgressBuild* pProgressBuild = SceneGenerator::Instance()->CreateProgressBuild();
-
-            auto segment = SceneGenerator::Instance()->CreateSceneSegment(m_pModel);
-            ObjectsSegment->AddSegment(segment);
-            Object::Connect(pProgressBuild, &ProgressBuild::BuildAllCompleted, this, &VisionScene::slotFinishBuildRep);
-            ::AddRefItem(m_pModel);
-            m_sceneLoadedSegments.push_back(segment);
-            m_MbModels.push_back(m_pModel);
+            if (builder == m_pLoadBuilder && m_pLoadProgress != nullptr)
+            {
+                m_pLoadProgress->setMaximum(maximum);
+                m_pLoadProgress->setValue(value);
+            }
+            emit buildProgress(value, maximum);
+            update();
+        });
+        connect(builder, &ProgressiveBuilder::finished, this, [this, builder]()
+        {
+            if (builder == m_pLoadBuilder)
+            {
+                m_pLoadBuilder = nullptr;
+                finishLoading();
+            }
+            update();
+        });
+
+        // the dialog stays up to cancel the build, but the scene can be turned meanwhile
+        if (m_pLoadProgress != nullptr)
+        {
+            const bool isVisible = m_pLoadProgress->isVisible();
+            m_pLoadProgress->hide();
+            m_pLoadProgress->setWindowModality(Qt::NonModal);
+            m_pLoadProgress->setLabelText(tr("Building %1").arg(fileName));
+            if (isVisible)
+                m_pLoadProgress->show();
         }
-        QApplication::restoreOverrideCursor();
+        builder->createProxies();
+        fitScene();
+        builder->start(viewport()->GetCamera()->GetPosition());
+        return;
     }
+
+    m_pLoadBuild = SceneGenerator::Instance()->CreateProgressBuild();
+    Object::Connect(m_pLoadBuild, &ProgressBuild::ValueModified, this, &VisionScene::slotLoadBuildProgress);
+    Object::Connect(m_pLoadBuild, &ProgressBuild::BuildAllCompleted, this, &VisionScene::slotLoadBuildCompleted);
+    m_pPendingSegment = SceneGenerator::Instance()->CreateSceneSegment(pModel);
+}
+
+void VisionScene::slotLoadBuildProgress(int value)
+{
+    if (m_pLoadProgress != nullptr && m_pLoadBuild != nullptr)
+    {
+        m_pLoadProgress->setMaximum(m_pLoadBuild->GetMaximum());
+        m_pLoadProgress->setValue(value);
+    }
+}
+
+void VisionScene::slotLoadBuildCompleted()
+{
+    SceneSegment* pSegment = m_pPendingSegment;
+    m_pPendingSegment = nullptr;
+    m_pLoadBuild = nullptr;
+
+    if (m_isLoadCanceled)
+    {
+        VSN_DELETE_AND_NULL(pSegment);
+        finishLoading();
+        return;
+    }
+    attachLoadedSegment(pSegment);
+}
+
+void VisionScene::attachLoadedSegment(SceneSegment* pSegment)
+{
+    ObjectsSegment->AddSegment(pSegment);
+    m_sceneLoadedSegments.push_back(pSegment);
+    addObject(pSegment);
+    finishLoading();
+    slotFinishBuildRep();
+}
+
+void VisionScene::slotBuildProgress(int value)
+{
+    if (m_pProgressBuild != nullptr)
+        emit buildProgress(value, m_pProgressBuild->GetMaximum());
 }
 
 void VisionScene::slotFinishBuildRep()
 {
+    // a loaded model finishes here too, it is not a run of the code builder
+    if (PROFILER.isOpen("Tessellation"))
+    {
+        PROFILER.end("Tessellation");
+        PROFILER.begin("First frame");
+    }
+    if (m_pProgressBuild != nullptr)
+    {
+        emit buildProgress(m_pProgressBuild->GetMaximum(), m_pProgressBuild->GetMaximum());
+        m_pProgressBuild = nullptr;
+    }
+    fitScene();
+}
+
+//-----------------------------------------------------------------------------
+// Culled objects are shown first so that every box counts.
+// ---
+void VisionScene::zoomToFit()
+{
+    m_culler.reset(*sceneContent()->GetContainer());
+    if (ObjectsSegment->GetBoundingBox().IsEmpty())
+        viewport()->ZoomToFit(sceneContent()->GetBoundingBox());
+    else
+        viewport()->ZoomToFit(ObjectsSegment->GetBoundingBox());
+    update();
+}
+
+void VisionScene::fitScene()
+{
+    m_culler.reset(*sceneContent()->GetContainer());
     sceneContent()->GetContainer()->SetUseVertexBufferObjects(true);
     if(m_isZoomToFit) viewport()->ZoomToFit(ObjectsSegment->GetBoundingBox());
     update();
@@ -539,19 +930,17 @@ void VisionScene::slotSelectionColor(const QColor& clr)
 
 void VisionScene::slotModelColor(const QColor& clr)
 {
+    const Color color(clr.red(), clr.green(), clr.blue());
     std::list<SelectionItem*> lstItem = m_ptrSelectManager->GetSelectionList();
-    //int index = 0;
-    for (std::list<SelectionItem*>::iterator it = lstItem.begin(); it != lstItem.end(); ++it)
+    for (SelectionItem* selectionItem : lstItem)
     {
-        if (InstSelectionItem* item = dynamic_cast<InstSelectionItem*>(*it))
+        if (InstSelectionItem* item = dynamic_cast<InstSelectionItem*>(selectionItem))
         {
-            auto segment = item->GetSceneSegment();
-            std::list<SceneSegment*> seg = ObjectsSegment->GetSegments();
-            for (auto& s : seg) {
-                if (segment == s) {
-                    s->SetColorPresentationMaterial(Color(clr.red(), clr.green(), clr.blue()));
-                }
-            }
+            // only the objects of the scene are recoloured, not their parts
+            SceneSegment* segment = item->GetSceneSegment();
+            const SceneObjectInfo* info = segment != nullptr ? objectInfo(segment->GetUniqueKey()) : nullptr;
+            if (info != nullptr && info->m_segment == segment)
+                segment->SetColorPresentationMaterial(color);
         }
     }
 }
@@ -569,33 +958,66 @@ QString VisionScene::typePrimitive(InstSelectionItem* item)
     return strText;
 }
 
+//-----------------------------------------------------------------------------
+// The console gets one append for the whole selection; a line per item made
+// select-all on a large assembly relayout the console thousands of times.
+// ---
 void VisionScene::signalItemSelectModified() {
     emit clearConsole();
+    QStringList lines;
     std::list<SelectionItem*> lstItem = m_ptrSelectManager->GetSelectionList();
-    //int index = 0;
-    for (std::list<SelectionItem*>::iterator it = lstItem.begin(); it != lstItem.end(); ++it)
+    for (SelectionItem* selectionItem : lstItem)
     {
-        if (InstSelectionItem* item = dynamic_cast<InstSelectionItem*>(*it))
+        if (InstSelectionItem* item = dynamic_cast<InstSelectionItem*>(selectionItem))
         {
-            String strKey = item->GetNodeKey().ToString();
-            QString type = m_mapKeyToString[item->GetNodeKey()].isEmpty() ? "N" : m_mapKeyToString[item->GetNodeKey()];
-            QString str = {"Type: " + typePrimitive(item) + ", NodeKey: " + QString::number(strKey.ToInt())
+            const NodeKey key = item->GetNodeKey();
+            const SceneObjectInfo* info = objectInfo(key);
+            const QString type = info == nullptr || info->m_typeFamily.isEmpty() ? QString("N") : info->m_typeFamily;
+            QString str = {"Type: " + typePrimitive(item) + ", NodeKey: " + QString::number(key.GetKey())
                 + ", TypeFamily: " + type + ", Body Id: " + QString::number(item->GetIndexBody()) +
                 ", Primitive Id: " + QString::number(item->GetPrimitiveId())};
-            sendToSceneMessage(str, ResultType::Standart);
+            ItemPath path;
+            for (auto builder : m_progressiveBuilders)
+            {
+                if (builder->findInstancePath(key, item->GetIndexBody(), path))
+                {
+                    QStringList names;
+                    for (const MbItem* pathItem : path)
+                        names.push_back(QString::number(pathItem->GetItemName()));
+                    str += ", Item Path: " + names.join("/");
+                    break;
+                }
+            }
+            lines.push_back(str);
         }
     }
+    if (!lines.isEmpty())
+        emit sendToSceneMessage(lines.join('\n'), ResultType::Standart);
 }
 
+//-----------------------------------------------------------------------------
+// No picking while a button drags the camera; the ID buffer is only drawn
+// again once the camera stops.
+// ---
 void VisionScene::mouseMoveEvent(QMouseEvent* event)
 {
     QtVision::QtOpenGLSceneWidget::mouseMoveEvent(event);
-    ObjectType type = ObjectType::None;
-    if (SelectionItem* item = m_ptrSelectManager->GetHighlightItem())
-        type = item->GetType();
+    if (event->buttons() == Qt::NoButton && context() != nullptr)
+    {
+        makeCurrent();
+        const qreal ratio = devicePixelRatio();
+        const PickBuffer::Hit hit = m_pickBuffer.pick(context(), *sceneContent()->GetContainer(),
+            viewport()->GetMultipleMatrix(), size() * ratio, QPoint(qRound(event->x() * ratio), qRound(event->y() * ratio)));
+        doneCurrent();
+        if (hit != m_hover)
+        {
+            m_hover = hit;
+            requestFrame();
+        }
+    }
 
     QCursor curCursor;
-    switch (type)
+    switch (m_hover.type)
     {
         case ObjectType::Vertex: curCursor = m_curVertex; break;
         case ObjectType::Edge:   curCursor = m_curEdge;   break;
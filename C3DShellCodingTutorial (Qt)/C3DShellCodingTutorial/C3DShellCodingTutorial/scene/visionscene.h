@@ -1,5 +1,7 @@
 ﻿#pragma once
 #include <QVector>
+#include <QHash>
+#include <QByteArray>
 
 #include <vsn_gridgeometry.h>
 #include <qt_openglwidget.h>
@@ -8,6 +10,9 @@
 
 #include "consoletext.h"
 #include "globaldef.h"
+#include "lodselector.h"
+#include "pickbuffer.h"
+#include "visibilityculler.h"
 
 #include <solid.h>
 //#include <last.h>
@@ -21,6 +26,10 @@ class SphereRep;
 VSN_END_NAMESPACE
 
 class MbRefItem;
+class ModelLoader;
+class ProgressiveBuilder;
+class QThread;
+class QProgressDialog;
 
 //struct TypeSpaceStr {
 //    QString typeStr;
@@ -58,6 +67,20 @@ struct SelectObjectInfo
     }
 };
 
+// Segment built from one Model of the last "Display" run
+struct DrawnObject
+{
+    SceneSegment* m_segment = nullptr;
+    const MbItem* m_item = nullptr;
+};
+
+// What the scene knows about a segment directly under ObjectsSegment
+struct SceneObjectInfo
+{
+    SceneSegment* m_segment = nullptr;
+    QString m_typeFamily; // empty for loaded models
+};
+
 class VisionScene : public QtVision::QtOpenGLSceneWidget
 {
     Q_OBJECT
@@ -80,11 +103,11 @@ public:
     int m_timerId = 0;
     void changeOrientation(Orientation orientation);
     void changeRenderMode(RenderMode mode);
+    void zoomToFit();
     QColor highlightColor() const;
     QColor selectionColor() const;
     void PrepareDictionary();
     QString typePrimitive(InstSelectionItem* item);
-    QMap<NodeKey, QString> m_mapKeyToString;
     QMap<MbeSpaceType, QString> m_mapSpaceTypeToString;
     void setFilter(bool bodyEnable);
     SelectionManagerPtr m_ptrSelectManager;
@@ -94,6 +117,22 @@ private:
     QVector<SceneSegment*> m_sceneLoadedSegments;
     QVector<SceneSegment*> m_pSceneAxis;
     QVector<MbModel*> m_MbModels;
+    QHash<QByteArray, DrawnObject> m_drawnObjects;
+    QHash<quint64, SceneObjectInfo> m_objectIndex; // by the NodeKey of the segment
+    ProgressBuild* m_pProgressBuild = nullptr;
+    ModelLoader* m_pModelLoader = nullptr;
+    QThread* m_pLoaderThread = nullptr;
+    QProgressDialog* m_pLoadProgress = nullptr;
+    ProgressBuild* m_pLoadBuild = nullptr;
+    SceneSegment* m_pPendingSegment = nullptr;
+    bool m_isLoadCanceled = false;
+    QVector<ProgressiveBuilder*> m_progressiveBuilders;
+    ProgressiveBuilder* m_pLoadBuilder = nullptr; // the build m_pLoadProgress shows
+    LodSelector m_lodSelector;
+    VisibilityCuller m_culler;
+    PickBuffer m_pickBuffer;
+    PickBuffer::Hit m_hover;
+    int m_pickGeneration = -1;
     BoxRep* m_pBoxRep;
     RenderObject m_box;
     MbPlacement3D m_place;
@@ -106,8 +145,24 @@ private:
     QCursor m_curVertex;
     QCursor m_curPoint;
 
+    bool isLoading() const;
+    void cancelLoading();
+    void releaseLoader();
+    bool stopBuild(ProgressBuild*& pBuild);
+    void finishLoading();
+    void attachLoadedSegment(SceneSegment* pSegment);
+    void slotModelLoaded();
+    void slotLoadBuildProgress(int value);
+    void slotLoadBuildCompleted();
+    void slotBuildProgress(int value);
     void slotFinishBuildRep();
+    void fitScene();
     void releaseRootSegment();
+    void releaseDrawnObject(DrawnObject& object);
+    void addObject(SceneSegment* pSegment, const QString& typeFamily = QString());
+    void removeObject(SceneSegment* pSegment);
+    const SceneObjectInfo* objectInfo(const NodeKey& key) const;
+    static QByteArray modelFingerprint(const Model& model);
     void setGradientImage();
     
 protected:
@@ -130,6 +185,7 @@ public slots:
     void slotModelColor(const QColor& clr);
 signals:
     void updateScene();
+    void buildProgress(int value, int maximum);
     void signalReadyForFocus();
     void sendToSceneMessage(const QString& txt, ConsoleText::ResultType t = ConsoleText::ResultType::Standart);
     void sendToSceneMessageColor(const QString& txt, const QColor& color);
@@ -0,0 +1,584 @@
+﻿#include <cstring>
+
+#include <QDir>
+#include <QSet>
+#include <QThread>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+
+#include "headerindex.h"
+#include "storagelocation.h"
+#include "globaldef.h"
+
+static const quint32 kHeaderIndexMagic = 0x48443343; // "C3DH"
+static const quint32 kHeaderIndexVersion = 1;
+
+// The file is this header, the string records, the header records, the lists
+// and the UTF-8 arena of the strings.
+struct HeaderIndexHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 headerCount;
+    quint32 stringCount;
+    quint32 listSize;  // quint32 each
+    quint32 arenaSize;
+    char kernelHash[20];
+};
+
+struct StringRecord
+{
+    quint32 offset;
+    quint32 size;
+};
+
+struct IndexRange
+{
+    quint32 first; // in the lists
+    quint32 count;
+};
+
+struct HeaderRecord
+{
+    quint32 name;
+    quint32 isUser;       // setup.h of the user folder
+    IndexRange lists[6];  // header ids for the includes, string ids for the rest
+};
+
+struct ParsedHeader
+{
+    QString name;
+    bool isUser = false;
+    QStringList includes;
+    HeaderSymbols symbols;
+};
+
+struct HeaderIndex::Merge
+{
+    HeaderSymbols symbols;
+    QSet<QString> seen[ListCount];
+};
+
+static const HeaderIndexHeader& indexHeader(const uchar* pData)
+{
+    return *reinterpret_cast<const HeaderIndexHeader*>(pData);
+}
+
+static const StringRecord* stringRecords(const uchar* pData)
+{
+    return reinterpret_cast<const StringRecord*>(pData + sizeof(HeaderIndexHeader));
+}
+
+static const HeaderRecord* headerRecords(const uchar* pData)
+{
+    return reinterpret_cast<const HeaderRecord*>(stringRecords(pData) + indexHeader(pData).stringCount);
+}
+
+static const quint32* indexLists(const uchar* pData)
+{
+    return reinterpret_cast<const quint32*>(headerRecords(pData) + indexHeader(pData).headerCount);
+}
+
+static const char* stringArena(const uchar* pData)
+{
+    return reinterpret_cast<const char*>(indexLists(pData) + indexHeader(pData).listSize);
+}
+
+static QString indexFileName()
+{
+    return APP.tempDir() + "/" + g_kDefaultHeaderIndexFileName;
+}
+
+//-----------------------------------------------------------------------------
+// Names, sizes and times of the headers, as for the precompiled header of
+// the code builder; the version makes a new format build the file anew.
+// ---
+static QByteArray currentKernelHash()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(reinterpret_cast<const char*>(&kHeaderIndexVersion), sizeof(kHeaderIndexVersion));
+
+    QFileInfoList headers = QDir(APP.kernelDir()).entryInfoList(QDir::Files, QDir::Name);
+    headers << QFileInfo(APP.userDir() + "/setup.h");
+    for (const QFileInfo& info : headers)
+    {
+        hash.addData(info.fileName().toUtf8());
+        const qint64 stamp[2] = { info.size(), info.lastModified().toMSecsSinceEpoch() };
+        hash.addData(reinterpret_cast<const char*>(stamp), sizeof(stamp));
+    }
+    return hash.result();
+}
+
+//-----------------------------------------------------------------------------
+// Global functions, types and the public methods of the classes of one header.
+// ---
+static ParsedHeader parseHeader(const QString& name, const QString& fileSource)
+{
+    ParsedHeader parsed;
+    parsed.name = name;
+    HeaderSymbols& symbols = parsed.symbols;
+
+    // Поиск заголовков в файле
+    QRegularExpression regExpIncludesPattern("#include\\s+(?:(\"(.*?)\")|(<(.*?)>))");
+    QRegularExpressionMatchIterator iRegInclude = regExpIncludesPattern.globalMatch(fileSource);
+    while (iRegInclude.hasNext())
+    {
+        QRegularExpressionMatch matchInc = iRegInclude.next();
+        QString include = !matchInc.captured(2).isEmpty() ? matchInc.captured(2) : matchInc.captured(4);
+        if (!parsed.includes.contains(include))
+            parsed.includes.append(include);
+    }
+
+    // Поиск глобальных функций
+    const QString strRegExFunctions("(?:^\\s*typedef\\s+|^\\s*MATH_FUNC\\s*\\(\\s*)(\\w+\\W*)(?:\\(\\s*\\*|\\s*\\**\\s*\\)\\s*)(\\w+)(?:[^(]*)(\\([\\s\\S]*?\\));");
+
+    QRegularExpression regExpFunctionsPattern(strRegExFunctions, QRegularExpression::PatternOption::MultilineOption);
+    QRegularExpressionMatchIterator  iRegFunctions = regExpFunctionsPattern.globalMatch(fileSource);
+
+    while (iRegFunctions.hasNext())
+    {
+        QRegularExpressionMatch matchFunctions = iRegFunctions.next();
+        QString tempStrFunction = QString("%2?4%3 -> %1").arg(matchFunctions.captured(1)).arg(matchFunctions.captured(2)).arg(matchFunctions.captured(3)).simplified();
+        if (!symbols.functionsAutoCmpl.contains(tempStrFunction))
+        {
+            // Для callTips
+            symbols.functionsAutoCmpl.append(tempStrFunction);
+            symbols.functionsAutoCmpl.append("::" + tempStrFunction);
+            // Добавление слов для автокомплита
+            if (!symbols.functionsHighlight.contains(matchFunctions.captured(2)))
+                symbols.functionsHighlight.append(matchFunctions.captured(2));
+        }
+    }
+
+    // Поиск классов, структур, перечислений и объединений
+    QRegularExpression regExpObjectsPattertn("(?:(class|struct).*?\\s+(\\w+?)\\s*[:;{]|(enum|unione).*?\\s+(\\w+?)\\s*[:;{]|(namespace).*?\\s+(\\w+?)\\s*[:;{])");
+    QRegularExpressionMatchIterator iRegClass = regExpObjectsPattertn.globalMatch(fileSource);
+
+    while (iRegClass.hasNext())
+    {
+        QRegularExpressionMatch match = iRegClass.next();
+        // Перечисления и объединения
+        if (!match.captured(4).isEmpty())
+        {
+            if (!symbols.typesHighlight.contains(match.captured(4)))
+            {
+                symbols.typesAutoCmpl.append(match.captured(4) + "?3");
+                symbols.typesHighlight.append(match.captured(4));
+            }
+        }
+        // Классы и структуры
+        else if (!match.captured(2).isEmpty())
+        {
+            if (!symbols.typesHighlight.contains(match.captured(2)))
+            {
+                symbols.typesHighlight.append(match.captured(2));
+                symbols.classes.append(match.captured(2));
+            }
+        }
+        // Пространства имен
+        else if (!match.captured(6).isEmpty())
+        {
+            if (!symbols.typesHighlight.contains(match.captured(6)))
+            {
+                symbols.typesHighlight.append(match.captured(6));
+                symbols.typesAutoCmpl.append(match.captured(6) + "?7");
+            }
+        }
+    }
+
+    //Поиск содержимого каждого класса
+    QString strRegExClassSourse("^\\s*(class|struct)\\s+(?:MATH_CLASS\\s+)?(\\w+)\\s+(?::[^{]+)?({(?>[^{}]+|(?3))*})");
+
+    QRegularExpression regExpClassPattertn(strRegExClassSourse, QRegularExpression::PatternOption::MultilineOption);
+    QRegularExpressionMatchIterator  iRegitClass = regExpClassPattertn.globalMatch(fileSource);
+
+    // Поиск внутри каждого класса между public: и (private: | protected:)
+    QRegularExpression regExpPublicPattern("^\\s*(?:public\\s*:)([\\s\\S]*?)(?:private\\s*:|protected\\s*:|};)", QRegularExpression::PatternOption::MultilineOption);
+    QRegularExpression regExpDstPattern("~.*?\\n", QRegularExpression::PatternOption::MultilineOption);
+    QRegularExpression regExpMethodsPattern("\\s*(?:virtual)?\\s*(\\w+\\s*[*&]?)(|\\s*(?:operator\\s*(?:\\(\\)|\\w+))|\\s+\\w+)\\s*(\\([\\s\\S]*?\\)?)(?:;|{|\\s+\\:)",
+        QRegularExpression::PatternOption::MultilineOption);
+
+    while (iRegitClass.hasNext())
+    {
+        QRegularExpressionMatch matchClass = iRegitClass.next();
+        QString type = matchClass.captured(1);
+        QString className = matchClass.captured(2);
+
+        QRegularExpressionMatchIterator iRegitPublic = regExpPublicPattern.globalMatch(matchClass.captured(3));
+
+        while (iRegitPublic.hasNext())
+        {
+            QRegularExpressionMatch matchPublic = iRegitPublic.next();
+            QString publicContent = matchPublic.captured();
+
+            // Удаление комментариев, так как в них есть 
+            // конструкции похожие на методы
+            HeaderIndex::removeComments(publicContent);
+
+            // Удаление деструкторов
+            QRegularExpressionMatchIterator  iRegitDst = regExpDstPattern.globalMatch(publicContent);
+
+            while (iRegitDst.hasNext())
+            {
+                QRegularExpressionMatch matchDst = iRegitDst.next();
+                publicContent.remove(matchDst.captured());
+            }
+
+            // Поиск методов каждого класса
+            QRegularExpressionMatchIterator  iRegitMethods = regExpMethodsPattern.globalMatch(publicContent);
+
+            while (iRegitMethods.hasNext())
+            {
+                QRegularExpressionMatch matchMethods = iRegitMethods.next();
+
+                // Конструкторы классов
+                if (className == matchMethods.captured(1).trimmed() || (className == matchMethods.captured(2).trimmed() && matchMethods.captured(1).trimmed() == "explicit"))
+                {
+                    QString classCtr = QString("%1?2%2.").arg(className).arg(matchMethods.captured(3)).simplified();
+                    if (!symbols.functionsAutoCmpl.contains(classCtr))
+                        symbols.functionsAutoCmpl.append(classCtr);
+                }
+                // Конструкторы классов, которые содержатся в другом классе
+                else if (matchMethods.captured(2) != className)
+                {
+                    if (matchMethods.captured(1) == "explicit")
+                    {
+                        QString classMethod = QString("%1?8%2. %3 %4.").arg(matchMethods.captured(2)).arg(matchMethods.captured(3))
+                            .arg(type).arg(className).simplified();
+                        if (!symbols.functionsAutoCmpl.contains(classMethod))
+                            symbols.functionsAutoCmpl.append(classMethod);
+                        if (!symbols.functionsHighlight.contains(matchMethods.captured(2)))
+                            symbols.functionsHighlight.append(matchMethods.captured(2));
+                    }
+                    // Методы
+                    else if (matchMethods.captured(1) != "return")
+                    {
+                        QString classMethod = QString("%2?4%3 -> %1. %4 %5.")
+                            .arg(matchMethods.captured(1)).arg(matchMethods.captured(2)).arg(matchMethods.captured(3))
+                            .arg(type).arg(className).simplified();
+                        if (!symbols.functionsAutoCmpl.contains(classMethod))
+                            symbols.functionsAutoCmpl.append(classMethod);
+                        if (!symbols.functionsHighlight.contains(matchMethods.captured(2)))
+                            symbols.functionsHighlight.append(matchMethods.captured(2));
+                    }
+                }
+            }
+        }
+    }
+    return parsed;
+}
+
+//-----------------------------------------------------------------------------
+// Parses every kernel header and setup.h of the user folder and writes the
+// index. Runs in the builder thread; gives up when the application quits.
+// ---
+static bool buildIndex(const QByteArray& kernelHash)
+{
+    QVector<ParsedHeader> parsed;
+    QHash<QString, quint32> kernelHeaders;
+
+    auto parseFile = [&parsed](const QString& name, const QString& path, bool isUser)
+    {
+        QFile header(path);
+        if (!header.open(QIODevice::ReadOnly))
+            return false;
+        parsed.push_back(parseHeader(name, QString::fromUtf8(header.readAll())));
+        parsed.back().isUser = isUser;
+        return true;
+    };
+
+    // setup.h of the user folder is what the user code includes
+    QDir kernel(APP.kernelDir());
+    for (const QString& name : kernel.entryList(QDir::Files, QDir::Name))
+    {
+        if (QThread::currentThread()->isInterruptionRequested())
+            return false;
+        if (name != "setup.h" && parseFile(name, kernel.filePath(name), false))
+            kernelHeaders.insert(name, quint32(parsed.size() - 1));
+    }
+    parseFile("setup.h", APP.userDir() + "/setup.h", true);
+
+    QHash<QString, quint32> stringIds;
+    QVector<StringRecord> strings;
+    QByteArray arena;
+    auto intern = [&](const QString& text)
+    {
+        auto it = stringIds.find(text);
+        if (it != stringIds.end())
+            return it.value();
+        const QByteArray utf8 = text.toUtf8();
+        strings.push_back({ quint32(arena.size()), quint32(utf8.size()) });
+        arena.append(utf8);
+        return stringIds.insert(text, quint32(strings.size() - 1)).value();
+    };
+
+    QVector<HeaderRecord> records;
+    QVector<quint32> lists;
+    for (const ParsedHeader& header : parsed)
+    {
+        HeaderRecord record = {};
+        record.name = intern(header.name);
+        record.isUser = header.isUser ? 1 : 0;
+
+        auto addList = [&](int list, const QStringList& names)
+        {
+            record.lists[list].first = quint32(lists.size());
+            for (const QString& name : names)
+                lists.push_back(intern(name));
+            record.lists[list].count = quint32(lists.size()) - record.lists[list].first;
+        };
+
+        // only kernel headers are followed, as the compiler finds them
+        record.lists[0].first = quint32(lists.size());
+        for (const QString& include : header.includes)
+        {
+            auto it = kernelHeaders.find(include);
+            if (it != kernelHeaders.end())
+                lists.push_back(it.value());
+        }
+        record.lists[0].count = quint32(lists.size()) - record.lists[0].first;
+
+        addList(1, header.symbols.typesHighlight);
+        addList(2, header.symbols.typesAutoCmpl);
+        addList(3, header.symbols.classes);
+        addList(4, header.symbols.functionsHighlight);
+        addList(5, header.symbols.functionsAutoCmpl);
+        records.push_back(record);
+    }
+
+    HeaderIndexHeader header = {};
+    header.magic = kHeaderIndexMagic;
+    header.version = kHeaderIndexVersion;
+    header.headerCount = quint32(records.size());
+    header.stringCount = quint32(strings.size());
+    header.listSize = quint32(lists.size());
+    header.arenaSize = quint32(arena.size());
+    std::memcpy(header.kernelHash, kernelHash.constData(), qMin(int(sizeof(header.kernelHash)), kernelHash.size()));
+
+    QSaveFile file(indexFileName());
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(strings.constData()), strings.size() * qint64(sizeof(StringRecord)));
+    file.write(reinterpret_cast<const char*>(records.constData()), records.size() * qint64(sizeof(HeaderRecord)));
+    file.write(reinterpret_cast<const char*>(lists.constData()), lists.size() * qint64(sizeof(quint32)));
+    file.write(arena);
+    return file.commit();
+}
+
+class HeaderIndexBuilder : public QThread
+{
+public:
+    explicit HeaderIndexBuilder(const QByteArray& kernelHash)
+        : m_kernelHash(kernelHash)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        buildIndex(m_kernelHash);
+    }
+
+private:
+    QByteArray m_kernelHash;
+};
+
+HeaderIndex& HeaderIndex::instance()
+{
+    static HeaderIndex singleton;
+    return singleton;
+}
+
+HeaderIndex::~HeaderIndex()
+{
+    if (m_pBuilder != nullptr)
+    {
+        m_pBuilder->requestInterruption();
+        m_pBuilder->wait();
+        delete m_pBuilder;
+    }
+    release();
+}
+
+void HeaderIndex::prepare()
+{
+    if (m_pData != nullptr || m_pBuilder != nullptr)
+        return;
+
+    m_kernelHash = currentKernelHash();
+    if (load())
+    {
+        emit ready();
+        return;
+    }
+
+    m_pBuilder = new HeaderIndexBuilder(m_kernelHash);
+    connect(m_pBuilder, &QThread::finished, this, [this]()
+    {
+        m_pBuilder->deleteLater();
+        m_pBuilder = nullptr;
+        if (load())
+            emit ready();
+    });
+    m_pBuilder->start(QThread::LowPriority);
+}
+
+bool HeaderIndex::isReady() const
+{
+    return m_pData != nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// The file is checked once here, so the lookups can trust its ids and ranges.
+// ---
+bool HeaderIndex::load()
+{
+    release();
+    m_file.setFileName(indexFileName());
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    HeaderIndexHeader header;
+    if (size < qint64(sizeof(header)) || (m_pData = m_file.map(0, size)) == nullptr)
+    {
+        release();
+        return false;
+    }
+
+    std::memcpy(&header, m_pData, sizeof(header));
+    const qint64 expectedSize = qint64(sizeof(header)) + qint64(header.stringCount) * sizeof(StringRecord) +
+        qint64(header.headerCount) * sizeof(HeaderRecord) + qint64(header.listSize) * sizeof(quint32) + header.arenaSize;
+    bool isValid = header.magic == kHeaderIndexMagic && header.version == kHeaderIndexVersion && size == expectedSize &&
+        m_kernelHash == QByteArray(header.kernelHash, sizeof(header.kernelHash));
+
+    const StringRecord* pStrings = stringRecords(m_pData);
+    for (quint32 i = 0; isValid && i < header.stringCount; ++i)
+        isValid = quint64(pStrings[i].offset) + pStrings[i].size <= header.arenaSize;
+
+    const HeaderRecord* pRecords = headerRecords(m_pData);
+    const quint32* pLists = indexLists(m_pData);
+    for (quint32 i = 0; isValid && i < header.headerCount; ++i)
+    {
+        isValid = pRecords[i].name < header.stringCount;
+        for (int list = 0; isValid && list < ListCount; ++list)
+        {
+            const IndexRange& range = pRecords[i].lists[list];
+            isValid = quint64(range.first) + range.count <= header.listSize;
+            const quint32 limit = list == Includes ? header.headerCount : header.stringCount;
+            for (quint32 j = 0; isValid && j < range.count; ++j)
+                isValid = pLists[range.first + j] < limit;
+        }
+    }
+
+    if (!isValid)
+    {
+        release();
+        return false;
+    }
+
+    for (quint32 i = 0; i < header.headerCount; ++i)
+        m_headers.insert(string(pRecords[i].name), int(i));
+    m_lastIncludes.clear();
+    m_lastSymbols = HeaderSymbols();
+    return true;
+}
+
+void HeaderIndex::release()
+{
+    if (m_pData != nullptr)
+        m_file.unmap(const_cast<uchar*>(m_pData));
+    m_pData = nullptr;
+    m_file.close();
+    m_headers.clear();
+}
+
+QString HeaderIndex::string(quint32 id) const
+{
+    const StringRecord& record = stringRecords(m_pData)[id];
+    return QString::fromUtf8(stringArena(m_pData) + record.offset, int(record.size));
+}
+
+HeaderSymbols HeaderIndex::symbols(const QStringList& includes)
+{
+    if (m_pData == nullptr)
+        return HeaderSymbols();
+    if (includes == m_lastIncludes)
+        return m_lastSymbols;
+
+    Merge merge;
+    QVector<bool> isVisited(int(indexHeader(m_pData).headerCount), false);
+    for (const QString& include : includes)
+    {
+        auto it = m_headers.find(include);
+        if (it != m_headers.end() && !isVisited[it.value()])
+            collect(it.value(), isVisited, merge);
+    }
+
+    m_lastIncludes = includes;
+    m_lastSymbols = merge.symbols;
+    return m_lastSymbols;
+}
+
+//-----------------------------------------------------------------------------
+// The included headers come first, each symbol once, as the editor used to
+// gather them when it read the headers itself.
+// ---
+void HeaderIndex::collect(int header, QVector<bool>& isVisited, Merge& merge) const
+{
+    isVisited[header] = true;
+    const HeaderRecord& record = headerRecords(m_pData)[header];
+    const quint32* pLists = indexLists(m_pData);
+
+    const IndexRange& includes = record.lists[Includes];
+    for (quint32 i = 0; i < includes.count; ++i)
+    {
+        const quint32 include = pLists[includes.first + i];
+        if (!isVisited[int(include)])
+            collect(int(include), isVisited, merge);
+    }
+
+    QStringList* targets[ListCount] = { nullptr, &merge.symbols.typesHighlight, &merge.symbols.typesAutoCmpl,
+        &merge.symbols.classes, &merge.symbols.functionsHighlight, &merge.symbols.functionsAutoCmpl };
+    for (int list = TypesHighlight; list < ListCount; ++list)
+    {
+        const IndexRange& range = record.lists[list];
+        for (quint32 i = 0; i < range.count; ++i)
+        {
+            const QString name = string(pLists[range.first + i]);
+            if (!merge.seen[list].contains(name))
+            {
+                merge.seen[list].insert(name);
+                targets[list]->append(name);
+            }
+        }
+    }
+}
+
+void HeaderIndex::removeComments(QString& source)
+{
+    //Удаление комментариев
+    QRegularExpression regExpLineCommentPattern("\\/\\/.*?\\n", QRegularExpression::PatternOption::MultilineOption);
+    QRegularExpression regExpBlockCommentsPattern("\\/\\*[\\s\\S]*?\\*\\/", QRegularExpression::PatternOption::MultilineOption);
+
+    QRegularExpressionMatchIterator  iRegitComment = regExpLineCommentPattern.globalMatch(source);
+
+    // Удаление строчных комментариев
+    while (iRegitComment.hasNext())
+    {
+        QRegularExpressionMatch matchComment = iRegitComment.next();
+        source.remove(matchComment.captured());
+    }
+
+    iRegitComment = regExpBlockCommentsPattern.globalMatch(source);
+
+    // Удаление блочных комментариев
+    while (iRegitComment.hasNext())
+    {
+        QRegularExpressionMatch matchComment = iRegitComment.next();
+        source.remove(matchComment.captured());
+    }
+}
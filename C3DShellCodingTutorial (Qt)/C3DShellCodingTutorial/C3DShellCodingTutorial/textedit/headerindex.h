@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+#define HEADER_INDEX HeaderIndex::instance()
+
+class QThread;
+
+// Names the editor highlights and completes, in the QsciAPIs entry format
+struct HeaderSymbols
+{
+    QStringList typesHighlight;
+    QStringList typesAutoCmpl;
+    QStringList classes;
+    QStringList functionsHighlight;
+    QStringList functionsAutoCmpl;
+};
+
+// Symbols and include graph of the kernel headers, parsed once per kernel into
+// a binary file of the temp directory and mapped from it. All editors share the
+// mapping; a change of the kernel headers or of setup.h builds the file anew.
+class HeaderIndex : public QObject
+{
+    Q_OBJECT
+public:
+    static HeaderIndex& instance();
+
+    // Maps the index, or builds it in a background thread first.
+    void prepare();
+    bool isReady() const;
+
+    // Symbols of the headers and of all the kernel headers they include.
+    // Empty until the index is ready.
+    HeaderSymbols symbols(const QStringList& includes);
+
+    static void removeComments(QString& source);
+
+signals:
+    void ready();
+
+private:
+    enum List { Includes, TypesHighlight, TypesAutoCmpl, Classes, FunctionsHighlight, FunctionsAutoCmpl, ListCount };
+
+    struct Merge;
+
+    HeaderIndex() = default;
+    ~HeaderIndex() override;
+
+    bool load();
+    void release();
+    QString string(quint32 id) const;
+    void collect(int header, QVector<bool>& isVisited, Merge& merge) const;
+
+    QFile m_file;
+    const uchar* m_pData = nullptr;
+    QByteArray m_kernelHash;
+    QHash<QString, int> m_headers; // by the name in an #include
+    QThread* m_pBuilder = nullptr;
+
+    QStringList m_lastIncludes; // an editor opened after another one asks the same
+    HeaderSymbols m_lastSymbols;
+};
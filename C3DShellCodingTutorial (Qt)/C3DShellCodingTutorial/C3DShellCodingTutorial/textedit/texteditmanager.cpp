@@ -16,6 +16,8 @@
 #include <QSettings>
 #include <QDomElement>
 #include <QDate>
+#include <QTimer>
+#include <QAction>
 //ads
 #include <DockManager.h>
 #include <DockWidget.h>
@@ -60,6 +62,8 @@ TextEditManager::TextEditManager(QObject* parent, ads::CDockManager* dockManager
     , m_pDockManager(dockManager)
     , m_pFindTextWidget(new FindTextWidget(nullptr))
     , m_pButtonDisplay (new QPushButton(QObject::tr("Display"), nullptr))
+    , m_pActionLivePreview(new QAction(QObject::tr("Live preview"), this))
+    , m_pLivePreviewTimer(new QTimer(this))
 //    , m_currentAppExecutablePath(QApplication::applicationDirPath())
 //    , m_listWorks()
 {
@@ -69,6 +73,15 @@ TextEditManager::TextEditManager(QObject* parent, ads::CDockManager* dockManager
 
     connect(m_pButtonDisplay, &QPushButton::clicked, this, &TextEditManager::slotDisplayCode);
 
+    QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
+    m_pActionLivePreview->setCheckable(true);
+    m_pActionLivePreview->setChecked(settings.value("Build/LivePreview", false).toBool());
+    m_livePreviewDelay = settings.value("Build/LivePreviewDelay", g_kDefaultLivePreviewDelay).toInt();
+    m_pActionLivePreview->setToolTip(QObject::tr("Display the code each time the typing stops"));
+    m_pLivePreviewTimer->setSingleShot(true);
+    connect(m_pActionLivePreview, &QAction::toggled, this, &TextEditManager::slotLivePreviewToggled);
+    connect(m_pLivePreviewTimer, &QTimer::timeout, this, &TextEditManager::slotLivePreview);
+
     connect(m_pFindTextWidget, &FindTextWidget::clickForFind, this, &TextEditManager::slotFind);
     connect(m_pFindTextWidget, &FindTextWidget::clickForReplace, this, &TextEditManager::slotReplace);
     connect(m_pFindTextWidget, &FindTextWidget::clickForReplaceAndFind, this, &TextEditManager::slotReplaceAndFind);
@@ -205,6 +218,8 @@ TextEditWidget* TextEditManager::createNewEditor(const QString& title, const QSt
     
     auto actionClear = optionsMenu->addAction(QObject::tr("Clear Editor"));
     auto actionCloseEditors = optionsMenu->addAction(QObject::tr("Close all Editors"));
+    optionsMenu->addSeparator();
+    optionsMenu->addAction(m_pActionLivePreview);
     auto actionCreateEditor = new QAction(dockWidget);
     actionCreateEditor->setToolTip(QObject::tr("Create Editor"));
     actionCreateEditor->setText(tr("Add"));
@@ -293,10 +308,35 @@ void TextEditManager::slotDisplayCode()
     Q_ASSERT(activeTextEdit != nullptr);
 
     m_pActiveTextEdit = activeTextEdit;
+    m_pLivePreviewTimer->stop();
     emit sendCode(m_pActiveTextEdit->text(), activeTextEdit->dockObjectName());
     m_pActiveTextEdit->unselectErrors();
 }
 //-----------------------------------------------------------------------------
+// The code builder drops a live build that gets stale, so the timer only
+// keeps a build from starting on every key.
+// ---
+void TextEditManager::slotLivePreview()
+{
+    if (m_pLiveTextEdit == nullptr)
+        return;
+
+    m_pLiveTextEdit->unselectErrors();
+    emit sendLiveCode(m_pLiveTextEdit->text(), m_pLiveTextEdit->dockObjectName());
+}
+//-----------------------------------------------------------------------------
+// 
+// ---
+void TextEditManager::slotLivePreviewToggled(bool enable)
+{
+    QSettings settings(APP.commonDir() + "/settings.ini", QSettings::IniFormat);
+    settings.setValue("Build/LivePreview", enable);
+    if (enable)
+        m_livePreviewDelay = settings.value("Build/LivePreviewDelay", g_kDefaultLivePreviewDelay).toInt();
+    else
+        m_pLivePreviewTimer->stop();
+}
+//-----------------------------------------------------------------------------
  
 // Вызов формы поиска и замены слов
 void TextEditManager::slotShowFindWidget()
@@ -534,6 +574,12 @@ void TextEditManager::slotTextIsChanged()
     // Получение названия текущей вкладки
     QString titleName = editorWidget->dockTitle();
 
+    if (m_pActionLivePreview->isChecked())
+    {
+        m_pLiveTextEdit = editorWidget;
+        m_pLivePreviewTimer->start(m_livePreviewDelay);
+    }
+
     if (editorWidget->isModified())
     {
 		// Если название не имеет *, то он добавляется
@@ -1,5 +1,6 @@
 #pragma once
 #include <QObject>
+#include <QPointer>
 
 namespace ads
 {
@@ -14,6 +15,8 @@ class QMenu;
 class QListWidget;
 class QPushButton;
 class QFile;
+class QAction;
+class QTimer;
 
 class TextEditWidget;
 class FindTextWidget;
@@ -35,6 +38,7 @@ public:
 
 signals:
     void sendCode(const QString& code, const QString& editorName);
+    void sendLiveCode(const QString& code, const QString& editorName);
     void signalSendButtonDisplay(QPushButton* buttonDisplay);
     void signalSendFindWidget(FindTextWidget* findWidget);
     void signalSearchInDocumentation(const QString textDoc);
@@ -64,6 +68,8 @@ protected:
 
 private slots:
     void slotDisplayCode();
+    void slotLivePreview();
+    void slotLivePreviewToggled(bool enable);
     void slotEditorCloseRequested();
     void slotPress();
     void slotEnter();
@@ -97,4 +103,9 @@ private:
     ads::CDockManager* m_pDockManager = nullptr;
     QPushButton* m_pButtonDisplay;
     FindTextWidget* m_pFindTextWidget;
+    // Live preview: the editor typed in last is built once the typing stops
+    QAction* m_pActionLivePreview;
+    QTimer* m_pLivePreviewTimer;
+    int m_livePreviewDelay = 0; // Build/LivePreviewDelay, read when the preview is turned on
+    QPointer<TextEditWidget> m_pLiveTextEdit;
 };
@@ -7,6 +7,7 @@
 #include "globaldef.h"
 #include "texteditor.h"
 #include "lexercxx.h"
+#include "headerindex.h"
 
 #include "Qsci/qsciapis.h"
 
@@ -77,6 +78,14 @@ TextEditor::TextEditor(QWidget* parent) : QsciScintilla(parent)
     connect(this, &QsciScintilla::textChanged,
         this, &TextEditor::slotSearchIncludes);
 
+    // Индекс заголовков строится в фоне при первом запуске;
+    // когда он готов, заголовки редактора разбираются заново
+    connect(&HEADER_INDEX, &HeaderIndex::ready, this, [this]()
+    {
+        m_Includes.clear();
+        slotSearchIncludes();
+    });
+
     // Выделение текущего слова
     connect(this, &QsciScintilla::cursorPositionChanged,
         this, &TextEditor::slotHighlighCurrentWord);
@@ -281,25 +290,19 @@ void TextEditor::slotSearchIncludes()
     // Добавление новых элементов в лексер и автокомплит
     if (tempIncludes != m_Includes)
     {
-        m_Includes.clear();
-        m_AllHeaders.clear();
-        m_headers.clear();
-
-        m_c3dTypesAutoCmpl.clear();
-        m_c3dTypesHighlight.clear();
-        m_c3dFunctionsAutoCmpl.clear();
-        m_c3dFunctionsHighlight.clear();
-
         api->clear();
 
         // Добавление новых заголовков
-        for (int i = 0; i < tempIncludes.length(); ++i)
-            m_Includes.append(tempIncludes[i]);
+        m_Includes = tempIncludes;
 
-        // Поиск классов, методов и т.д. и добавление их
-        // в массивы для подсветки и автодополнения
-        for (QString include : m_Includes)
-            traversalHeaders(include, regExpIncludesPattern);
+        // Классы, методы и т.д. из индекса заголовков ядра,
+        // общего для всех редакторов
+        HeaderSymbols symbols = HEADER_INDEX.symbols(m_Includes);
+        m_c3dTypesAutoCmpl = symbols.typesAutoCmpl;
+        m_c3dTypesHighlight = symbols.typesHighlight;
+        m_c3dFunctionsAutoCmpl = symbols.functionsAutoCmpl;
+        m_c3dFunctionsHighlight = symbols.functionsHighlight;
+        m_classes = symbols.classes;
 
         // Передача названий классов, структур, перечислителей
         // объединений и пространства имен для подсветки
@@ -336,227 +339,6 @@ void TextEditor::slotSearchIncludes()
     searchVariables();
 }
 
-void TextEditor::traversalHeaders(const QString include, const QRegularExpression regExpIncludesPattern)
-{
-    QFile header;
-
-    if (include == "setup.h")
-        header.setFileName(APP.userDir() + "/" + include);
-    else
-        header.setFileName(APP.kernelDir() + "/" + include);
-
-    // Проверка был ли этот заголовок уже осмотрен
-    if (!m_headers.contains(include))
-    {
-        if (header.exists() && header.open(QIODevice::ReadOnly))
-        {
-            // Содержимое файла
-            QString fileSource = header.readAll();
-            header.close();
-
-            // Поиск заголовков в файле
-            QRegularExpressionMatch match = regExpIncludesPattern.match(fileSource);
-            QRegularExpressionMatchIterator iRegInclude = regExpIncludesPattern.globalMatch(fileSource);
-
-            if (match.hasMatch())
-            {
-                while (iRegInclude.hasNext())
-                {
-                    // Поиск новых заголовков для обхода
-                    QRegularExpressionMatch matchInc = iRegInclude.next();
-                    QString include = !matchInc.captured(2).isEmpty() ? matchInc.captured(2) : matchInc.captured(4);
-                    header.setFileName(APP.kernelDir() + "/" + include);
-
-                    if (header.exists() && header.open(QIODevice::ReadOnly))
-                    {
-                        header.close();
-                        if (!m_AllHeaders.contains(include))
-                        {
-                            m_AllHeaders.append(include);
-                            // Рекурсивный обход заголовков
-                            traversalHeaders(include, regExpIncludesPattern);
-                        }
-                        else
-                            continue;
-                    }
-                    else
-                        continue;
-                }
-            }
-
-            // Поиск глобальных функций
-             const QString strRegExFunctions("(?:^\\s*typedef\\s+|^\\s*MATH_FUNC\\s*\\(\\s*)(\\w+\\W*)(?:\\(\\s*\\*|\\s*\\**\\s*\\)\\s*)(\\w+)(?:[^(]*)(\\([\\s\\S]*?\\));");
-
-             QRegularExpression regExpFunctionsPattern(strRegExFunctions, QRegularExpression::PatternOption::MultilineOption);
-             QRegularExpressionMatchIterator  iRegFunctions = regExpFunctionsPattern.globalMatch(fileSource);
-    
-             while (iRegFunctions.hasNext())
-             {
-                 QRegularExpressionMatch matchFunctions = iRegFunctions.next();
-                 QString tempStrFunction = QString("%2?4%3 -> %1").arg(matchFunctions.captured(1)).arg(matchFunctions.captured(2)).arg(matchFunctions.captured(3)).simplified();
-                 if (!m_c3dFunctionsAutoCmpl.contains(tempStrFunction))
-                 {
-                     // Для callTips
-                     m_c3dFunctionsAutoCmpl.append(tempStrFunction.simplified());
-                     m_c3dFunctionsAutoCmpl.append("::" + tempStrFunction.simplified());
-                     //qDebug() << tempStrFunction.trimmed();
-                     // Добавление слов для автокомплита
-                     if (!m_c3dFunctionsHighlight.contains(matchFunctions.captured(2)))
-                         m_c3dFunctionsHighlight.append(matchFunctions.captured(2));
-                 }
-             }
-
-            // Поиск классов, структур, перечислений и объединений
-            QRegularExpression regExpObjectsPattertn("(?:(class|struct).*?\\s+(\\w+?)\\s*[:;{]|(enum|unione).*?\\s+(\\w+?)\\s*[:;{]|(namespace).*?\\s+(\\w+?)\\s*[:;{])");
-            QRegularExpressionMatchIterator iRegClass = regExpObjectsPattertn.globalMatch(fileSource);
-
-            while (iRegClass.hasNext())
-            {
-                QRegularExpressionMatch match = iRegClass.next();
-                // Перечисления и объединения
-                if (!match.captured(4).isEmpty())
-                {
-                    if (!m_c3dTypesHighlight.contains(match.captured(4)))
-                    {
-                        m_c3dTypesAutoCmpl.append(match.captured(4) + "?3");
-                        m_c3dTypesHighlight.append(match.captured(4));
-                    }
-                }
-                // Классы и структуры
-                else if (!match.captured(2).isEmpty())
-                {
-                    if (!m_c3dTypesHighlight.contains(match.captured(2)))
-                    {
-                        m_c3dTypesHighlight.append(match.captured(2));
-                        m_classes.append(match.captured(2));
-                    }
-                }
-                // Пространства имен
-                else if (!match.captured(6).isEmpty())
-                {
-                    if (!m_c3dTypesHighlight.contains(match.captured(6)))
-                    {
-                        m_c3dTypesHighlight.append(match.captured(6));
-                        m_c3dTypesAutoCmpl.append(match.captured(6) + "?7");
-                    }
-                }
-            }
-
-            //Поиск содержимого каждого класса
-            QString strRegExClassSourse("^\\s*(class|struct)\\s+(?:MATH_CLASS\\s+)?(\\w+)\\s+(?::[^{]+)?({(?>[^{}]+|(?3))*})");
-
-            QRegularExpression regExpClassPattertn(strRegExClassSourse, QRegularExpression::PatternOption::MultilineOption);
-            QRegularExpressionMatchIterator  iRegitClass = regExpClassPattertn.globalMatch(fileSource);
-            
-            while (iRegitClass.hasNext())
-            {
-                QRegularExpressionMatch matchClass = iRegitClass.next();
-                QString type = matchClass.captured(1);
-                QString className = matchClass.captured(2);
-
-                // Поиск внутри каждого класса между public: и (private: | protected:)
-                QString strRegExPublic("^\\s*(?:public\\s*:)([\\s\\S]*?)(?:private\\s*:|protected\\s*:|};)");
-                QRegularExpression regExpPublicPattern(strRegExPublic, QRegularExpression::PatternOption::MultilineOption);
-                QRegularExpressionMatchIterator iRegitPublic = regExpPublicPattern.globalMatch(matchClass.captured(3));
-            
-                while (iRegitPublic.hasNext())
-                {
-                    QRegularExpressionMatch matchPublic = iRegitPublic.next();
-                    QString publicContent = matchPublic.captured();
-                    
-                    // Удаление комментариев, так как в них есть 
-                    // конструкции похожие на методы
-                    deleteCommentsRegExp(publicContent);
-                    
-                    // Удаление деструкторов
-                    QRegularExpression regExpDstPattern("~.*?\\n", QRegularExpression::PatternOption::MultilineOption); 
-                    QRegularExpressionMatchIterator  iRegitDst = regExpDstPattern.globalMatch(publicContent);
-                    
-                    while (iRegitDst.hasNext())
-                    {
-                        QRegularExpressionMatch matchDst = iRegitDst.next();
-                        publicContent.remove(matchDst.captured());
-                    }
-
-                    // Поиск методов каждого класса
-                    QString strRegExMethods("\\s*(?:virtual)?\\s*(\\w+\\s*[*&]?)(|\\s*(?:operator\\s*(?:\\(\\)|\\w+))|\\s+\\w+)\\s*(\\([\\s\\S]*?\\)?)(?:;|{|\\s+\\:)");
-                    QRegularExpression regExpMethodsPattern(strRegExMethods, QRegularExpression::PatternOption::MultilineOption);
-                    QRegularExpressionMatchIterator  iRegitMethods = regExpMethodsPattern.globalMatch(publicContent);
-                    
-                    while (iRegitMethods.hasNext())
-                    {
-                        QRegularExpressionMatch matchMethods = iRegitMethods.next();
-
-                        // Конструкторы классов
-                        if (className == matchMethods.captured(1).trimmed() || (className == matchMethods.captured(2).trimmed() && matchMethods.captured(1).trimmed() == "explicit"))
-                        {
-                                QString classCtr = QString("%1?2%2.").arg(className).arg(matchMethods.captured(3)).simplified();
-                                if (!m_c3dFunctionsAutoCmpl.contains(classCtr.simplified()))
-                                    m_c3dFunctionsAutoCmpl.append(classCtr.simplified()); 
-                        }
-                         // Конструкторы классов, которые содержатся в другом классе
-                        else if (matchMethods.captured(2) != className)
-                        {
-                            if (matchMethods.captured(1) == "explicit")
-                            {
-                                
-                                QString classMethod = QString("%1?8%2. %3 %4.").arg(matchMethods.captured(2)).arg(matchMethods.captured(3))
-                                    .arg(type).arg(className).simplified();
-                                if (!m_c3dFunctionsAutoCmpl.contains(classMethod.simplified()))
-                                    m_c3dFunctionsAutoCmpl.append(classMethod.simplified());
-                                if (!m_c3dFunctionsHighlight.contains(matchMethods.captured(2)))
-                                    m_c3dFunctionsHighlight.append(matchMethods.captured(2));
-                            }
-                            // Методы
-                            else
-                            {
-                                if (matchMethods.captured(1) != "return")
-                                {
-                                    QString classMethod = QString("%2?4%3 -> %1. %4 %5.")
-                                        .arg(matchMethods.captured(1)).arg(matchMethods.captured(2)).arg(matchMethods.captured(3))
-                                        .arg(type).arg(className).simplified();
-                                    if (!m_c3dFunctionsAutoCmpl.contains(classMethod.simplified()))
-                                        m_c3dFunctionsAutoCmpl.append(classMethod.simplified());
-                                    if (!m_c3dFunctionsHighlight.contains(matchMethods.captured(2)))
-                                        m_c3dFunctionsHighlight.append(matchMethods.captured(2));
-                                }
-                            }
-                        }
-                        
-                    }
-                }
-            }
-        }
-        // Добавляем название файла, чтобы не обходить его снова
-        m_headers.append(include);
-    }
-}
-
-void TextEditor::deleteCommentsRegExp(QString& source)
-{
-    //Удаление комментариев
-    QRegularExpression regExpLineCommentPattern("\\/\\/.*?\\n", QRegularExpression::PatternOption::MultilineOption);
-    QRegularExpression regExpBlockCommentsPattern("\\/\\*[\\s\\S]*?\\*\\/", QRegularExpression::PatternOption::MultilineOption);
-
-    QRegularExpressionMatchIterator  iRegitComment = regExpLineCommentPattern.globalMatch(source);
-
-    // Удаление строчных комментариев
-    while (iRegitComment.hasNext())
-    {
-        QRegularExpressionMatch matchComment = iRegitComment.next();
-        source.remove(matchComment.captured());
-    }
-
-    iRegitComment = regExpBlockCommentsPattern.globalMatch(source);
-
-    // Удаление блочных комментариев
-    while (iRegitComment.hasNext())
-    {
-        QRegularExpressionMatch matchComment = iRegitComment.next();
-        source.remove(matchComment.captured());
-    }
-}
-
 void TextEditor::searchVariables()
 {
     QString currentDoc = text();
@@ -564,7 +346,7 @@ void TextEditor::searchVariables()
 
     // Удаление комментариев, чтобы 
     // не захватывать переменные из комментариев
-    deleteCommentsRegExp(currentDoc);
+    HeaderIndex::removeComments(currentDoc);
 
     // Поиск переменных
     QString strRegExVariables("^(?:[\\s\\W])*(?:constexpr|inline|extern|const|static|volatile|mutable)*\\s[\\w]+(?:<[^>]*>)*(?:[\\s*&]|const)+(\\w+)");
@@ -655,6 +437,8 @@ void TextEditor::defaultFunctionsAutoCmpl()
 
 void TextEditor::getIncludes()
 {
+    HEADER_INDEX.prepare();
+
     QStringList includes;
     // Добавление в массив includes всех названий заголовочных
     // файлой ядра c3d
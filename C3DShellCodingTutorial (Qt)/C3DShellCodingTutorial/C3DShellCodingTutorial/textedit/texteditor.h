@@ -33,8 +33,6 @@ class TextEditor : public QsciScintilla
     };
 
     QStringList m_Includes;
-    QStringList m_AllHeaders;
-    QStringList m_headers;
 
     QStringList m_classes;
 
@@ -52,10 +50,6 @@ class TextEditor : public QsciScintilla
     void defaultFunctionsHighlight();
     void defaultFunctionsAutoCmpl();
 
-    // Рекурсивный обход заголовочных фалйлов c3d 
-    // и добавление названий классов функций и др в массивы.
-    void traversalHeaders(const QString include, const QRegularExpression regExpIncludesPattern);
-
     void searchVariables();
     
     // Функция для цвета скобок соответствия
@@ -68,8 +62,6 @@ class TextEditor : public QsciScintilla
 
     static void getIncludes();
 
-    void deleteCommentsRegExp(QString& source);
-
     protected:
     void keyPressEvent(QKeyEvent* e) override;
     
@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Protocol between CodeRunner of the application and the C3DCodeHost process.
+// Requests and replies are single lines on the standard input and output:
+//   run <library>\t<key>   ->  done <ok> <size>  or  failed <reason>
+//   release                    drops the shared memory of the last run
+// Before its answer a run reports how long it took:
+//   span <name>\t<start>\t<duration>      nanoseconds since the request was read
+//   kernel <name>\t<milliseconds>\t<count> one of the slowest kernel operations
+// The results of a run are left in the shared memory segment <key>: a
+// ResultHeader, then the model and text records, the UTF-8 text arena and the
+// kernel stream of the model items. Whatever the user code prints goes to the
+// standard error of the host.
+namespace CodeHost
+{
+    const uint32_t kResultMagic = 0x52443343; // "C3DR"
+    const uint32_t kResultVersion = 1;
+    const size_t kKernelTimingCount = 20;
+
+    struct ResultHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t isOk;            // what entry_point returned
+        uint32_t modelCount;      // ModelRecord each
+        uint32_t messageCount;    // TextRecord each
+        uint32_t messageBoxCount; // two TextRecords each, the title and the text
+        uint64_t textOffset;
+        uint64_t textSize;
+        uint64_t itemsOffset;     // the items in the order of the models
+        uint64_t itemsSize;
+    };
+
+    struct ModelRecord
+    {
+        uint32_t style;
+        uint32_t width;
+        uint32_t color;
+        uint32_t reserved;
+    };
+
+    // A range of the text arena
+    struct TextRecord
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+} // namespace CodeHost
@@ -0,0 +1,237 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define dup _dup
+#define dup2 _dup2
+#define fdopen _fdopen
+#else
+#include <unistd.h>
+#endif
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLibrary>
+#include <QSharedMemory>
+
+#include <model_item.h>
+#include <io_tape.h>
+#include <io_memory_buffer.h>
+#include <tool_time_test.h>
+#include <qt_openglwidget.h>
+
+#include "resultblock.h"
+#include "codehostprotocol.h"
+
+// Runs the user code of C3DShellCodingTutorial out of its process, so a crash or
+// an endless loop in it costs a restart of the host rather than the application.
+// Reads requests from the standard input until it is closed, see codehostprotocol.h.
+
+#ifdef Q_OS_WIN
+#define DLL_CALL __cdecl
+#else
+#define DLL_CALL
+#endif
+
+static void reportSpan(FILE* pReplies, const char* name, qint64 start, qint64 end)
+{
+    std::fprintf(pReplies, "span %s\t%lld\t%lld\n", name, static_cast<long long>(start), static_cast<long long>(end - start));
+}
+
+//-----------------------------------------------------------------------------
+// The kernel measures the operations marked with BeginTime and EndTime while
+// the time test is on; the slowest of the run are reported by name.
+// ---
+static void reportKernelTimings(FILE* pReplies)
+{
+    TimeTest* pTimeTest = ::GetTimeTestResults();
+    if (pTimeTest == nullptr)
+        return;
+
+    std::vector<TimeTestResult> results;
+    ::SortResultMeasuring(*pTimeTest, results);
+    std::sort(results.begin(), results.end(), [](const TimeTestResult& a, const TimeTestResult& b)
+    {
+        return a.timeResult > b.timeResult;
+    });
+
+    for (size_t i = 0; i < results.size() && i < CodeHost::kKernelTimingCount; ++i)
+    {
+        TimeTestResult& result = results[i];
+#ifdef _UNICODE
+        const QString name = QString::fromStdWString(result.name);
+#else
+        const QString name = QString::fromLocal8Bit(result.name.c_str());
+#endif
+        const QString line = QString("kernel %1\t%2\t%3\n").arg(name.simplified()).arg(result.GetMiliseconds(), 0, 'f', 3).arg(result.count);
+        std::fputs(line.toUtf8().constData(), pReplies);
+    }
+    pTimeTest->ClearTime();
+}
+
+//-----------------------------------------------------------------------------
+// Lays the results out in a new shared memory segment. The kernel writes the
+// items into a membuf first and toMemory copies it into the segment once: a
+// segment cannot grow, and its size is known only when the stream is done.
+// The text ranges and the arena of the block are taken over as they are.
+// ---
+static std::unique_ptr<QSharedMemory> writeResults(const QString& key, const ResultBlock& block, QString& error)
+{
+    membuf memBuf;
+    {
+        writer::writer_ptr out = writer::CreateMemWriter(memBuf, io::out);
+        if (!out || !out->good())
+        {
+            error = "Cannot create the kernel writer";
+            return nullptr;
+        }
+        for (uint32_t i = 0; i < block.modelCount; ++i)
+            *out << block.models[i].item;
+        if (!out->good())
+        {
+            error = "Cannot write the models";
+            return nullptr;
+        }
+    }
+    memBuf.closeBuff();
+
+    using namespace CodeHost;
+    static_assert(sizeof(TextRecord) == sizeof(ResultText), "the text ranges are copied as they are");
+
+    const size_t textCount = block.messageCount + 2 * size_t(block.messageBoxCount);
+    ResultHeader header = {};
+    header.magic = kResultMagic;
+    header.version = kResultVersion;
+    header.isOk = block.isOk;
+    header.modelCount = block.modelCount;
+    header.messageCount = block.messageCount;
+    header.messageBoxCount = block.messageBoxCount;
+
+    const uint64_t recordsOffset = sizeof(ResultHeader);
+    const uint64_t textRecordsOffset = recordsOffset + block.modelCount * sizeof(ModelRecord);
+    header.textOffset = textRecordsOffset + textCount * sizeof(TextRecord);
+    header.textSize = block.textSize;
+    header.itemsOffset = (header.textOffset + header.textSize + 7) & ~uint64_t(7);
+    header.itemsSize = memBuf.getMemLen();
+
+    auto pMemory = std::make_unique<QSharedMemory>(key);
+    if (!pMemory->create(int(header.itemsOffset + header.itemsSize)))
+    {
+        error = pMemory->errorString();
+        return nullptr;
+    }
+
+    char* pData = static_cast<char*>(pMemory->data());
+    std::memcpy(pData, &header, sizeof(header));
+
+    ModelRecord* pModels = reinterpret_cast<ModelRecord*>(pData + recordsOffset);
+    for (uint32_t i = 0; i < block.modelCount; ++i)
+        pModels[i] = { block.models[i].style, block.models[i].width, block.models[i].color, 0 };
+
+    std::memcpy(pData + textRecordsOffset, block.texts, textCount * sizeof(TextRecord));
+    std::memcpy(pData + header.textOffset, block.textArena, size_t(block.textSize));
+
+    const char* pItems = pData + header.itemsOffset;
+    memBuf.toMemory(pItems, size_t(header.itemsSize));
+    return pMemory;
+}
+
+//-----------------------------------------------------------------------------
+// Loads the library, runs the user code and hands its results over to the
+// application. The library is unloaded again, so the next build may overwrite it.
+// The steps are timed from the moment the request was read.
+// ---
+static std::unique_ptr<QSharedMemory> runLibrary(const QString& libraryName, const QString& key, FILE* pReplies,
+    const QElapsedTimer& clock, bool& isOk, QString& error)
+{
+    using dllRunUserCode = const ResultBlock* (DLL_CALL*)(uint32_t version);
+    using dllFreeResults = void(DLL_CALL*)(const ResultBlock* block);
+
+    QLibrary library(libraryName);
+    if (!library.load())
+    {
+        error = library.errorString();
+        return nullptr;
+    }
+
+    dllRunUserCode runUserCode = (dllRunUserCode)(library.resolve("run_user_code"));
+    dllFreeResults freeResults = (dllFreeResults)(library.resolve("free_results"));
+    if (runUserCode == nullptr || freeResults == nullptr)
+    {
+        error = "The library does not export run_user_code, dllmain.cpp is out of date";
+        library.unload();
+        return nullptr;
+    }
+
+    const qint64 loaded = clock.nsecsElapsed();
+    reportSpan(pReplies, "Load library", 0, loaded);
+
+    const ResultBlock* pBlock = runUserCode(RESULT_BLOCK_VERSION);
+    const qint64 ran = clock.nsecsElapsed();
+    reportSpan(pReplies, "User code", loaded, ran);
+    reportKernelTimings(pReplies);
+    if (pBlock == nullptr)
+    {
+        error = "The library was built for another version of the results";
+        library.unload();
+        return nullptr;
+    }
+
+    isOk = pBlock->isOk != 0;
+    std::unique_ptr<QSharedMemory> pResults = writeResults(key, *pBlock, error);
+    reportSpan(pReplies, "Write results", ran, clock.nsecsElapsed());
+
+    // the application has its own copies now
+    for (uint32_t i = 0; i < pBlock->modelCount; ++i)
+        ::ReleaseItem(pBlock->models[i].item);
+    freeResults(pBlock);
+    library.unload();
+    return pResults;
+}
+
+int main(int argc, char** argv)
+{
+    Math::SetMultithreadedMode(mtm_Off);
+
+    // the replies get their own stream, everything else printed goes to the
+    // standard error and shows up in the console of the application
+    FILE* pReplies = fdopen(dup(1), "w");
+    dup2(2, 1);
+
+    QCoreApplication app(argc, argv);
+    if (pReplies == nullptr || !QtVision::ActivateLicense(false))
+        return 1;
+    // cleared after each run, see reportKernelTimings
+    ::SetTimeTest(true);
+
+    std::unique_ptr<QSharedMemory> pResults;
+    char buffer[4096];
+    while (std::fgets(buffer, sizeof(buffer), stdin) != nullptr)
+    {
+        QElapsedTimer clock;
+        clock.start();
+        const QString request = QString::fromUtf8(buffer).trimmed();
+        pResults.reset();
+        if (!request.startsWith("run "))
+            continue; // release
+
+        const QStringList args = request.mid(4).split('\t');
+        bool isOk = false;
+        QString error;
+        if (args.size() == 2)
+            pResults = runLibrary(args[0], args[1], pReplies, clock, isOk, error);
+
+        if (pResults != nullptr)
+            std::fprintf(pReplies, "done %d %d\n", isOk ? 1 : 0, pResults->size());
+        else
+            std::fprintf(pReplies, "failed %s\n", error.isEmpty() ? "Bad request" : error.simplified().toUtf8().constData());
+        std::fflush(pReplies);
+        std::fflush(stdout);
+    }
+    return 0;
+}
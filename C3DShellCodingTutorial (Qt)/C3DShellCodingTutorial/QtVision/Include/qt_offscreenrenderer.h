@@ -0,0 +1,96 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/**
+  \file
+  \brief \ru Класс QtOffscreenRenderer выполняет рендеринг сцены Vision без окна.
+         \en QtOffscreenRenderer class renders a Vision scene without a window. \~
+*/
+////////////////////////////////////////////////////////////////////////////////
+#ifndef __QT_OFFSCREENRENDERER_H
+#define __QT_OFFSCREENRENDERER_H
+
+#include <QSize>
+
+#include <vsn_vision.h>
+#include <vsn_image.h>
+#include <vsn_graphicsview.h>
+#include <vsn_graphicssceneengine.h>
+#include "qt_visiondef.h"
+
+class QOffscreenSurface;
+
+VSN_BEGIN_NAMESPACE
+
+class OpenGLFramebufferObject;
+
+/** \brief \ru ВНИМАНИЕ! Этот файл не является частью API Vision. Он необходим для иллюстрации использования
+               ядра Vision с библиотекой Qt и ее классами. Этот заголовочный файл может изменяться от версии
+               к версии без предупреждения или полностью удаляться.
+           \en WARNING! The file is not a part of API Vision. It is needed to illustrate using of the Vision kernel
+               with Qt library and its classes. This header file can be changed from version to version with
+               no warning or completely deleted.\~
+*/
+
+namespace QtVision {
+
+class QtOffscreenContext;
+//------------------------------------------------------------------------------
+/** \brief \ru Класс QtOffscreenRenderer выполняет рендеринг сцены Vision в буфер кадра без видимого окна.
+           \en QtOffscreenRenderer class renders a Vision scene into a framebuffer without a visible window. \~
+    \details \ru QtOffscreenRenderer создает QOffscreenSurface, собственный контекст OpenGL и
+                 OpenGLFramebufferObject, в который GraphicsView выполняет DoRender. Класс работает
+                 с платформой Qt "offscreen" и программной реализацией OpenGL (например, Mesa llvmpipe
+                 через EGL без поверхности), поэтому подходит для сборочных серверов без GPU.
+             \en QtOffscreenRenderer creates a QOffscreenSurface, its own OpenGL context and an
+                 OpenGLFramebufferObject into which GraphicsView performs DoRender. The class works
+                 with the Qt "offscreen" platform and software OpenGL (e.g. Mesa llvmpipe over
+                 surfaceless EGL), so it suits build servers without a GPU. \n \~
+    \ingroup Vision_OpenGL
+*/
+// ---
+class QT_CLASS QtOffscreenRenderer
+{
+public:
+    /// \ru Конструктор. \en Constructor. \~
+    explicit QtOffscreenRenderer(GraphicsSceneEnginePtr ptrEngine, const QSize& size);
+    /// \ru Деструктор освобождает созданные ресурсы. \en Destructor releases created resources. \~
+    ~QtOffscreenRenderer();
+public:
+    /// \ru Вернуть true, если контекст и буфер кадра созданы. \en Returns true if the context and the framebuffer are created. \~
+    bool isValid() const;
+    /// \ru Вернуть размер буфера кадра. \en Returns framebuffer size. \~
+    QSize size() const;
+    /// \ru Изменить размер буфера кадра. \en Resizes the framebuffer. \~
+    void resize(const QSize& size);
+public:
+    /// \ru Вернуть указатель на GraphicsView. \en Returns pointer to GraphicsView. \~
+    GraphicsViewPtr graphicsView() const;
+    /// \ru Вернуть указатель на Viewport для отображения сцены. \en Returns a pointer to Viewport to display a scene. \~
+    Viewport* viewport() const;
+    /// \ru Вернуть указатель на содержимое сцены. \en Returns a pointer to scene content. \~
+    SceneContentPtr sceneContent() const;
+public:
+    /// \ru Установить контекст текущим. \en Makes the context current. \~
+    bool makeCurrent();
+    /// \ru Освободить контекст. \en Releases the context. \~
+    void doneCurrent();
+    /// \ru Нарисовать кадр и дождаться окончания работы OpenGL. \en Renders a frame and waits for OpenGL to finish. \~
+    void render();
+    /// \ru Вернуть изображение последнего кадра. \en Returns an image of the last frame. \~
+    Image grabImage();
+private:
+    void updateFramebufferBinding();
+private:
+    GraphicsViewPtr m_ptrGraphicsView;
+    QOffscreenSurface* m_pSurface;
+    QtOffscreenContext* m_pContext;
+    OpenGLFramebufferObject* m_pFramebuffer;
+    QSize m_size;
+private:
+    Q_DISABLE_COPY(QtOffscreenRenderer);
+};
+
+} // namespace QtVision
+
+VSN_END_NAMESPACE
+
+#endif // __QT_OFFSCREENRENDERER_H
@@ -397,7 +397,7 @@ private:
 class QtOpenGLContext : public QOpenGLContext, public OpenGLContextInterface
 {
 public:
-    explicit QtOpenGLContext(QWindow* pWindow, RenderingAreaFormat frm);
+    explicit QtOpenGLContext(QSurface* pSurface, RenderingAreaFormat frm);
     virtual ~QtOpenGLContext();
 public:
     virtual bool MakeCurrent();
@@ -412,7 +412,7 @@ public:
     virtual OpenGLContextContainer* GetContextContainer() const override;
     virtual bool IsOpenGLES() const override;
 protected:
-    QWindow* m_pWindow;
+    QSurface* m_pSurface;
     RenderingAreaFormat m_areaFormat;
     OpenGLContextContainer* m_pContextContainer;
     QtOpenGLFunctionList* m_pFuncs;
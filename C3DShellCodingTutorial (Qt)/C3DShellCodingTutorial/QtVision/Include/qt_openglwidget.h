@@ -39,6 +39,7 @@ VSN_BEGIN_NAMESPACE
 namespace QtVision {
 
 class QtOpenGLWidgetPrivate;
+class QtConverterEventListener;
 //------------------------------------------------------------------------------
 /** \brief \ru Класс QtOpenGLWidget реализует интеграцию Vision c Qt.
            \en QtOpenGLWidget class implements integration of Vision with Qt. \~
@@ -95,6 +96,9 @@ public:
     /// \ru Просто вызывает функцию QWidget::repaint(). Служит для совместимости слотов.
     /// \en Just calls QWidget::repaint() function. Serves for compatibility of slots. \~
     VSN_SLOT(Public, repaintWidget, void repaintWidget())
+    /// \ru Запросить перерисовку кадра. Несколько запросов за один такт обновления объединяются в один кадр.
+    /// \en Requests a frame. Several requests within one refresh tick are merged into a single frame. \~
+    VSN_SLOT(Public, requestFrame, void requestFrame())
 protected:
     /// \ru Инициализация OpenGL ресурсов. \en Initialises OpenGL resources. \~
     virtual void initializeGL() override;
@@ -103,8 +107,12 @@ protected:
 protected:
     QtOpenGLWidget(QtOpenGLWidgetPrivate& dd, QWidget* parent, Qt::WindowFlags f);
     VSN_DECLARE_PRIVATE(QtOpenGLWidget);
+private:
+    bool processFrameRequest();
+    void setIdleListener(QtConverterEventListener* pListener);
 private:
     Q_DISABLE_COPY(QtOpenGLWidget);
+    friend class QtConverterEventListener;
 };
 
 class QtOpenGLSceneWidgetPrivate;
@@ -183,7 +191,9 @@ VSN_DECLARE_FLAGS(ProcessTypes, ProcessType)
 QT_FUNC(void) CreateProcessesCameraControls(Node* pParent, ProcessTypes prType = pt_AllProcess);
 /// \ru This is method is deprecated, use ActivateLicense
 QT_FUNC(bool) isExistLicense();
-QT_FUNC(bool) ActivateLicense();
+/// \ru Активировать лицензию. Если bInteractive == false, предупреждение не показывается (для работы без экрана).
+/// \en Activates the license. If bInteractive == false, no warning is shown (for headless runs). \~
+QT_FUNC(bool) ActivateLicense(bool bInteractive = true);
 
 } // namespace QtVision
 
@@ -44,6 +44,8 @@ public:
 public:
     /// \ru Установить слушателя событий. \en Sets event listener.
     void setListenerEvent(Object* pListenerEvent);
+    /// \ru Вернуть таймер к частоте кадров после простоя. \en Returns the timer to the frame rate after idling.
+    void wake();
 protected:
     bool keyPressEvent(QKeyEvent* event);
     bool keyReleaseEvent(QKeyEvent* event);
@@ -57,9 +59,14 @@ protected:
     /// \ru Перегрузка для внутренних работ. \en Overload for internal workings.
     virtual bool eventFilter(QObject* watched, QEvent* event);
     virtual void timerEvent(QTimerEvent* event);
+private:
+    void startIdleTimer(int interval);
 protected:
     Object* m_pListenerEvent;
     int m_idleTimerId;
+    int m_frameInterval; ///< мс между тактами, пока запрашиваются кадры
+    int m_idleTicks;     ///< тактов подряд без кадра
+    bool m_bIdle;        ///< таймер редко опрашивает события Vision
 };
 
 class QtOpenGLContextShell;
@@ -72,6 +79,8 @@ public:
     explicit QtOpenGLWidgetPrivate(OpenGLContextContainer* pSharedContainer = nullptr)
         : m_bInitialized(false)
         , m_bUpdatePending(false)
+        , m_bFrameRequested(false)
+        , m_pIdleListener(nullptr)
         , m_pSharedContainer(pSharedContainer)
         , m_pQContext(nullptr)
     {
@@ -87,6 +96,8 @@ public:
 public:
     bool m_bInitialized;    ///< признак инициализация контекста
     bool m_bUpdatePending;
+    bool m_bFrameRequested; ///< сцена изменилась, кадр будет перерисован на следующем такте
+    QtConverterEventListener* m_pIdleListener; ///< таймер простоя, который будит requestFrame
     OpenGLContextContainer* m_pSharedContainer;
     QtOpenGLContextShell* m_pQContext;
 };
@@ -0,0 +1,189 @@
+﻿#include "qt_offscreenrenderer.h"
+#include <QSurfaceFormat>
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QOpenGLFunctions>
+
+#include <vsn_openglfbo.h>
+#include <vsn_viewport.h>
+#include <vsn_graphicsscene.h>
+
+#include "qt_openglcontext.h"
+
+#include <last.h>
+
+VSN_BEGIN_NAMESPACE
+namespace QtVision {
+
+//------------------------------------------------------------------------------
+// Контекст поверхности без окна. Vision привязывает буфер кадра по умолчанию
+// перед рисованием, поэтому им должен быть наш OpenGLFramebufferObject, а не 0.
+// ---
+class QtOffscreenContext : public QtOpenGLContext
+{
+public:
+    explicit QtOffscreenContext(QSurface* pSurface)
+        : QtOpenGLContext(pSurface, RenderingAreaFormat())
+        , m_framebufferId(0)
+    {
+    }
+public:
+    virtual GLuint GetDefaultFrameBufferObject() const override { return m_framebufferId; }
+public:
+    GLuint m_framebufferId;
+};
+
+
+/* QtOffscreenRenderer */
+QtOffscreenRenderer::QtOffscreenRenderer(GraphicsSceneEnginePtr ptrEngine, const QSize& size)
+    : m_ptrGraphicsView(std::make_shared<GraphicsView>(ptrEngine))
+    , m_pSurface(new QOffscreenSurface)
+    , m_pContext(nullptr)
+    , m_pFramebuffer(nullptr)
+    , m_size(size)
+{
+    const QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    m_pSurface->setFormat(format);
+    m_pSurface->create();
+
+    m_pContext = new QtOffscreenContext(m_pSurface);
+    m_pContext->setFormat(format);
+    if (!m_pContext->create() || !m_pContext->MakeCurrent())
+        return;
+
+    // Сглаживание выполняется в буфере кадра, поверхность без окна его не имеет.
+    m_pFramebuffer = new OpenGLFramebufferObject(m_size.width(), m_size.height(), format.samples() > 0 ? format.samples() : 0, true, true);
+    updateFramebufferBinding();
+
+    m_ptrGraphicsView->Initialize();
+    m_ptrGraphicsView->DoResize(m_size.width(), m_size.height());
+    m_ptrGraphicsView->PreparingToDisplay();
+    m_pContext->DoneCurrent();
+}
+
+//-----------------------------------------------------------------------------
+// Деструктор освобождает созданные ресурсы.
+// ---
+QtOffscreenRenderer::~QtOffscreenRenderer()
+{
+    if (m_pContext != nullptr && m_pContext->isValid())
+        m_pContext->MakeCurrent();
+    m_ptrGraphicsView.reset();
+    VSN_DELETE_AND_NULL(m_pFramebuffer);
+    if (m_pContext != nullptr)
+        m_pContext->DoneCurrent();
+    VSN_DELETE_AND_NULL(m_pContext);
+    VSN_DELETE_AND_NULL(m_pSurface);
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть true, если контекст и буфер кадра созданы.
+// ---
+bool QtOffscreenRenderer::isValid() const
+{
+    return m_pFramebuffer != nullptr && m_pFramebuffer->IsValid();
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть размер буфера кадра.
+// ---
+QSize QtOffscreenRenderer::size() const
+{
+    return m_size;
+}
+
+//-----------------------------------------------------------------------------
+// Изменить размер буфера кадра.
+// ---
+void QtOffscreenRenderer::resize(const QSize& size)
+{
+    if (size == m_size || !isValid() || !makeCurrent())
+        return;
+    m_size = size;
+    m_pFramebuffer->Update(m_size.width(), m_size.height());
+    updateFramebufferBinding();
+    m_ptrGraphicsView->DoResize(m_size.width(), m_size.height());
+    doneCurrent();
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть указатель на GraphicsView.
+// ---
+GraphicsViewPtr QtOffscreenRenderer::graphicsView() const
+{
+    return m_ptrGraphicsView;
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть указатель на Viewport для отображения сцены.
+// ---
+Viewport* QtOffscreenRenderer::viewport() const
+{
+    return m_ptrGraphicsView->GetViewport().get();
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть указатель на содержимое сцены.
+// ---
+SceneContentPtr QtOffscreenRenderer::sceneContent() const
+{
+    return m_ptrGraphicsView->GetGraphicsScene()->GetSceneContent();
+}
+
+//-----------------------------------------------------------------------------
+// Установить контекст текущим.
+// ---
+bool QtOffscreenRenderer::makeCurrent()
+{
+    return m_pContext != nullptr && m_pContext->MakeCurrent();
+}
+
+//-----------------------------------------------------------------------------
+// Освободить контекст.
+// ---
+void QtOffscreenRenderer::doneCurrent()
+{
+    if (m_pContext != nullptr)
+        m_pContext->DoneCurrent();
+}
+
+//-----------------------------------------------------------------------------
+// Нарисовать кадр. glFinish нужен, чтобы замер времени включал работу драйвера,
+// а не только постановку команд в очередь.
+// ---
+void QtOffscreenRenderer::render()
+{
+    if (!isValid() || !makeCurrent())
+        return;
+    m_pFramebuffer->Bind();
+    m_ptrGraphicsView->DoRender();
+    m_pContext->functions()->glFinish();
+    m_pFramebuffer->Release();
+    doneCurrent();
+}
+
+//-----------------------------------------------------------------------------
+// Вернуть изображение последнего кадра.
+// ---
+Image QtOffscreenRenderer::grabImage()
+{
+    if (!isValid() || !makeCurrent())
+        return Image();
+    Image image = m_pFramebuffer->MakeImage();
+    doneCurrent();
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// Запомнить идентификатор буфера кадра, чтобы контекст вернул его как буфер по умолчанию.
+// ---
+void QtOffscreenRenderer::updateFramebufferBinding()
+{
+    GLint framebufferId = 0;
+    m_pFramebuffer->Bind();
+    m_pContext->functions()->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebufferId);
+    m_pFramebuffer->Release();
+    m_pContext->m_framebufferId = GLuint(framebufferId);
+}
+
+} // namespace QtVision
+VSN_END_NAMESPACE
@@ -387,8 +387,8 @@ void QtOpenGLExtraFunctionList::glVertexBindingDivisor(GLuint bindingindex, GLui
 //----------------------------------------------------------------------------
 //
 // ---
-QtOpenGLContext::QtOpenGLContext(QWindow* pWindow, RenderingAreaFormat frm)
-    : m_pWindow(pWindow)
+QtOpenGLContext::QtOpenGLContext(QSurface* pSurface, RenderingAreaFormat frm)
+    : m_pSurface(pSurface)
     , m_areaFormat(frm)
     , m_pContextContainer(new OpenGLContextContainer)
     , m_pFuncs(nullptr)
@@ -412,7 +412,7 @@ QtOpenGLContext::~QtOpenGLContext()
 // ---
 bool QtOpenGLContext::MakeCurrent()
 {
-    if (QOpenGLContext::makeCurrent(m_pWindow))
+    if (QOpenGLContext::makeCurrent(m_pSurface))
     {
         m_pContextInterface = static_cast<OpenGLContextInterface*>((QtOpenGLContext*)QOpenGLContext::currentContext());
         if (m_pFuncs == nullptr)
@@ -443,7 +443,7 @@ void QtOpenGLContext::DoneCurrent()
 // ---
 void QtOpenGLContext::SwapBuffers()
 {
-    QOpenGLContext::swapBuffers(m_pWindow);
+    QOpenGLContext::swapBuffers(m_pSurface);
 }
 
 //----------------------------------------------------------------------------
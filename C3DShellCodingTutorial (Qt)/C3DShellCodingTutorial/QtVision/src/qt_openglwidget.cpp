@@ -28,15 +28,27 @@ VSN_BEGIN_NAMESPACE
 namespace QtVision {
 
 
+// Такт опроса событий Vision в простое и длительность простоя до перехода на него.
+static const int c_idlePollInterval = 250;
+static const int c_idleDelay = 1000;
+
 /* QtConverterEventListener */
 QtConverterEventListener::QtConverterEventListener(QObject* pParent)
     : QObject(pParent)
     , m_pListenerEvent(nullptr)
     , m_idleTimerId(-1)
+    , m_frameInterval(16)
+    , m_idleTicks(0)
+    , m_bIdle(false)
 {
     parent()->installEventFilter(this);
 #ifndef VSN_PLATFORM_WINDOWS
-    m_idleTimerId = startTimer(QGuiApplication::primaryScreen()->refreshRate());
+    const qreal refreshRate = QGuiApplication::primaryScreen()->refreshRate();
+    if (refreshRate > 0.0)
+        m_frameInterval = qMax(1, qRound(1000.0 / refreshRate));
+    startIdleTimer(m_frameInterval);
+    if (QtOpenGLWidget* pOpenGLWidget = qobject_cast<QtOpenGLWidget*>(parent()))
+        pOpenGLWidget->setIdleListener(this);
 #endif
 }
 
@@ -45,9 +57,33 @@ QtConverterEventListener::QtConverterEventListener(QObject* pParent)
 // ---
 QtConverterEventListener::~QtConverterEventListener()
 {
+    if (QtOpenGLWidget* pOpenGLWidget = qobject_cast<QtOpenGLWidget*>(parent()))
+        pOpenGLWidget->setIdleListener(nullptr);
     parent()->removeEventFilter(this);
 }
 
+//-----------------------------------------------------------------------------
+// Запрошен кадр: таймер снова идет с частотой кадров.
+// ---
+void QtConverterEventListener::wake()
+{
+    m_idleTicks = 0;
+    if (!m_bIdle)
+        return;
+    m_bIdle = false;
+    startIdleTimer(m_frameInterval);
+}
+
+//-----------------------------------------------------------------------------
+//
+// ---
+void QtConverterEventListener::startIdleTimer(int interval)
+{
+    if (m_idleTimerId != -1)
+        killTimer(m_idleTimerId);
+    m_idleTimerId = startTimer(interval);
+}
+
 //-----------------------------------------------------------------------------
 // Установить слушателя событий
 // ---
@@ -272,15 +308,23 @@ bool QtConverterEventListener::eventFilter(QObject* watched, QEvent* event)
 }
 
 //-----------------------------------------------------------------------------
-//
+// Доставить отложенные события Vision и перерисовать кадр, только если его запросили.
+// После секунды без кадров таймер лишь изредка опрашивает события Vision, пока
+// requestFrame не разбудит его.
 // ---
 void QtConverterEventListener::timerEvent(QTimerEvent* event)
 {
     if (event->timerId() == m_idleTimerId)
     {
         BaseApplication::OnProcessSendPostedEvents();
-        if (QtOpenGLWidget* pOpenGLWidget = qobject_cast<QtOpenGLWidget*>(parent()))
-            pOpenGLWidget->update();
+        QtOpenGLWidget* pOpenGLWidget = qobject_cast<QtOpenGLWidget*>(parent());
+        if (pOpenGLWidget != nullptr && pOpenGLWidget->processFrameRequest())
+            m_idleTicks = 0;
+        else if (!m_bIdle && ++m_idleTicks * m_frameInterval >= c_idleDelay)
+        {
+            m_bIdle = true;
+            startIdleTimer(c_idlePollInterval);
+        }
     }
     else
         QObject::timerEvent(event);
@@ -411,6 +455,44 @@ void QtOpenGLWidget::repaintWidget()
     repaint();
 }
 
+//-----------------------------------------------------------------------------
+// Запросить перерисовку кадра. Без таймера простоя (Windows) события Vision доставляются
+// в основном цикле, поэтому достаточно QWidget::update(), который также объединяет запросы.
+// ---
+void QtOpenGLWidget::requestFrame()
+{
+#ifdef VSN_PLATFORM_WINDOWS
+    update();
+#else
+    VSN_D(QtOpenGLWidget);
+    d.m_bFrameRequested = true;
+    if (d.m_pIdleListener != nullptr)
+        d.m_pIdleListener->wake();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Перерисовать кадр, если с прошлого такта поступил запрос. Вернуть true, если кадр запрошен.
+// ---
+bool QtOpenGLWidget::processFrameRequest()
+{
+    VSN_D(QtOpenGLWidget);
+    if (!d.m_bFrameRequested)
+        return false;
+    d.m_bFrameRequested = false;
+    update();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+//
+// ---
+void QtOpenGLWidget::setIdleListener(QtConverterEventListener* pListener)
+{
+    VSN_D(QtOpenGLWidget);
+    d.m_pIdleListener = pListener;
+}
+
 //-----------------------------------------------------------------------------
 //
 // ---
@@ -507,7 +589,7 @@ void QtOpenGLSceneWidgetPrivate::initialize()
     m_ptrGraphicsView->Initialize();
     m_pEventFilter = new QtConverterEventListener(&p);
     m_pEventFilter->setListenerEvent(m_ptrGraphicsView->GetGraphicsScene());
-    Object::Connect(m_ptrGraphicsView.get(), &GraphicsView::OnViewModified, &p, &QtOpenGLWidget::repaintWidget);
+    Object::Connect(m_ptrGraphicsView.get(), &GraphicsView::OnViewModified, &p, &QtOpenGLWidget::requestFrame);
 
     m_bVsnInitialized = true;
 }
@@ -525,12 +607,12 @@ void QtOpenGLSceneWidgetPrivate::processActivation()
         {
 			Process* pProcess = (*it);
             pProcess->SetViewport(m_ptrGraphicsView->GetViewport().get());
-			bool bConnect = Object::Connect(pProcess, &Process::OnModified, &p, &QtOpenGLWidget::repaintWidget);
+			bool bConnect = Object::Connect(pProcess, &Process::OnModified, &p, &QtOpenGLWidget::requestFrame);
 			Q_ASSERT(bConnect != false);
 
 			if (PrAbstractCamera* pAbsProcess = vobject_cast<PrAbstractCamera*>(pProcess))
 			{
-				bConnect = Object::Connect(pAbsProcess, &PrAbstractCamera::OnCameraModified, &p, &QtOpenGLWidget::repaintWidget);
+				bConnect = Object::Connect(pAbsProcess, &PrAbstractCamera::OnCameraModified, &p, &QtOpenGLWidget::requestFrame);
 				Q_ASSERT(bConnect != false);
 			}
         }
@@ -550,12 +632,12 @@ void QtOpenGLSceneWidgetPrivate::processDeactivation()
         {
 			Process* pProcess = (*it);
             pProcess->SetViewport(m_ptrGraphicsView->GetViewport().get());
-			bool bConnect = Object::Disconnect(pProcess, &Process::OnModified, &p, &QtOpenGLWidget::repaintWidget);
+			bool bConnect = Object::Disconnect(pProcess, &Process::OnModified, &p, &QtOpenGLWidget::requestFrame);
 //			Q_ASSERT(bConnect != false);
 
 			if (PrAbstractCamera* pAbsProcess = vobject_cast<PrAbstractCamera*>(pProcess))
 			{
-				bConnect = Object::Disconnect(pAbsProcess, &PrAbstractCamera::OnCameraModified, &p, &QtOpenGLWidget::repaintWidget);
+				bConnect = Object::Disconnect(pAbsProcess, &PrAbstractCamera::OnCameraModified, &p, &QtOpenGLWidget::requestFrame);
 //				Q_ASSERT(bConnect != false);
 			}
         }
@@ -677,6 +759,7 @@ void QtOpenGLSceneWidget::paintGL()
     VSN_D(QtOpenGLSceneWidget);
     if (d.m_pQContext == nullptr)
         return;
+    d.m_bFrameRequested = false;
     d.m_pQContext->MakeCurrent();
     d.m_ptrGraphicsView->DoRender();
     d.m_pQContext->DoneCurrent();
@@ -741,7 +824,7 @@ void QtOpenGLSceneWidget::ZoomToFit()
 bool QtOpenGLSceneWidget::OnEvent(ProcessEvent* event)
 {
     if (event->GetType() == ProcessEvent::Draw)
-        repaint();
+        requestFrame();
     return Object::OnEvent(event);
 }
 
@@ -799,7 +882,7 @@ QT_FUNC(bool) isExistLicense()
 }
 
 
-QT_FUNC(bool) ActivateLicense()
+QT_FUNC(bool) ActivateLicense(bool bInteractive)
 {
     std::string key = strKey;
     std::string signature = strSignature;
@@ -816,6 +899,8 @@ QT_FUNC(bool) ActivateLicense()
     ::EnableMathModules(key.c_str(), static_cast<int>(key.length()), signature.c_str(), static_cast<int>(signature.length()));
     if (!IsMathVisionEnable())
     {
+        if (!bInteractive)
+            return false;
         QMessageBox::warning(nullptr, QObject::tr("Warning"), QObject::tr("The evaluation period has expired. For a new license, please contact C3D Labs."));
         return false;
     }
@@ -0,0 +1,293 @@
+﻿#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QSurfaceFormat>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+#include <vsn_application.h>
+#include <vsn_scenegenerator.h>
+#include <vsn_scenecontent.h>
+#include <vsn_scenesegment.h>
+#include <vsn_viewport.h>
+#include <vsn_camera.h>
+#include <vsn_scenerepbuilder.h>
+#include <model.h>
+#include <mb_variables.h>
+
+#include "qt_openglwidget.h"
+#include "qt_offscreenrenderer.h"
+
+#include "globaldef.h"
+#include "modelloader.h"
+#include "progressivebuilder.h"
+#include "lodselector.h"
+#include "visibilityculler.h"
+
+// Headless render benchmark: loads every model of the Models folder, builds its
+// scene and renders it offscreen along fixed camera paths. Prints one row per model.
+// Models are loaded, built and drawn with the classes of the application, in its
+// multithreading mode; the mesh cache starts empty, so every build is a cold one.
+//
+// The Qt offscreen platform is the default, it still needs an OpenGL driver
+// reachable through EGL. Without a GPU use software OpenGL, e.g.
+//   LIBGL_ALWAYS_SOFTWARE=1 EGL_PLATFORM=surfaceless RenderBenchmark --frames 60
+// or set QT_QPA_PLATFORM to another platform that provides OpenGL.
+
+using namespace QtVision;
+
+struct BenchmarkResult
+{
+    qint64 loadMs = 0;
+    qint64 buildMs = 0;
+    qint64 firstFrameMs = 0;
+    double staticFps = 0.0;
+    double orbitFps = 0.0;
+    double tumbleFps = 0.0;
+};
+
+// The mapped file read of VisionScene, here on the calling thread.
+static MbModel* loadModel(const QString& fileName)
+{
+    ModelLoader loader(fileName);
+    loader.process();
+    return loader.takeModel();
+}
+
+static void resetCamera(QtOffscreenRenderer& renderer, SceneSegment* pSegment)
+{
+    renderer.graphicsView()->SetOrientationCamera(Orientation::IsoXYZ, false);
+    renderer.viewport()->ZoomToFit(pSegment->GetBoundingBox());
+}
+
+// Frame of VisionScene without occlusion: the levels of detail for this camera,
+// then the draw. Occlusion culling reads the depth of the widget framebuffer,
+// which the offscreen renderer does not have.
+struct SceneView
+{
+    ProgressiveBuilder* pBuilder = nullptr;
+    LodSelector lodSelector;
+    VisibilityCuller culler;
+
+    SceneView()
+    {
+        culler.setEnabled(false);
+    }
+};
+
+static void renderFrame(QtOffscreenRenderer& renderer, SceneView& view)
+{
+    if (view.pBuilder != nullptr && renderer.makeCurrent())
+    {
+        const MbMatrix3D viewProjection = renderer.viewport()->GetMultipleMatrix();
+        const MbMatrix3D projection = renderer.viewport()->GetProjectionMatrix();
+        view.lodSelector.select(view.pBuilder->lodGroups(), viewProjection, projection, renderer.size().height());
+        view.culler.cull(*renderer.sceneContent()->GetContainer(), viewProjection, view.lodSelector);
+        renderer.doneCurrent();
+    }
+    renderer.render();
+}
+
+// The same split as VisionScene: ProgressiveBuilder tessellates solids and
+// assemblies on its worker threads, SceneGenerator builds everything else.
+static void buildScene(QtOffscreenRenderer& renderer, MbModel* pModel, SceneSegment* pSegment,
+                       const QString& cacheDir, SceneView& view)
+{
+    if (SceneRepresentationBuilder::IsSupported(pModel))
+    {
+        view.pBuilder = new ProgressiveBuilder(pModel, pSegment, cacheDir);
+        QEventLoop loop;
+        QObject::connect(view.pBuilder, &ProgressiveBuilder::finished, &loop, &QEventLoop::quit);
+        view.pBuilder->createProxies();
+        resetCamera(renderer, pSegment);
+        view.pBuilder->start(renderer.viewport()->GetCamera()->GetPosition());
+        loop.exec();
+        return;
+    }
+
+    bool completed = false;
+    ProgressBuild* pBuild = SceneGenerator::Instance()->CreateProgressBuild();
+    Object::Connect(pBuild, &ProgressBuild::BuildAllCompleted, pBuild, [&completed]() { completed = true; });
+    SceneGenerator::Instance()->CreateSceneSegment(pModel, pSegment);
+    while (!completed)
+    {
+        BaseApplication::OnProcessSendPostedEvents();
+        QCoreApplication::processEvents();
+        QThread::msleep(1);
+    }
+}
+
+// Renders frameCount frames, turning the camera by a full circle about axis
+// (a zero axis keeps the camera still). Returns frames per second.
+static double runCameraPath(QtOffscreenRenderer& renderer, SceneSegment* pSegment, SceneView& view, const MbVector3D& axis, int frameCount)
+{
+    resetCamera(renderer, pSegment);
+    MbCartPoint3D center;
+    pSegment->GetBoundingBox().GetCenter(center);
+    const double step = M_PI2 / frameCount;
+    const bool rotate = axis.Length() > 0.0;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frameCount; ++i)
+    {
+        if (rotate)
+            renderer.viewport()->GetCamera()->RotateAbout(axis, step, center);
+        renderFrame(renderer, view);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    return elapsed > 0 ? frameCount * 1.0e9 / elapsed : 0.0;
+}
+
+static bool runModel(QtOffscreenRenderer& renderer, const QString& fileName, int frameCount, const QString& imageDir, BenchmarkResult& result)
+{
+    QTemporaryDir cacheDir;
+    QElapsedTimer timer;
+
+    timer.start();
+    MbModel* pModel = loadModel(fileName);
+    result.loadMs = timer.elapsed();
+    if (pModel == nullptr)
+        return false;
+    ::AddRefItem(pModel);
+
+    SceneSegment* pRoot = renderer.sceneContent()->GetRootSegment();
+    SceneSegment* pSegment = new SceneSegment();
+    pRoot->AddSegment(pSegment);
+
+    SceneView view;
+    timer.restart();
+    buildScene(renderer, pModel, pSegment, cacheDir.path(), view);
+    BaseApplication::OnProcessSendPostedEvents();
+    result.buildMs = timer.elapsed();
+
+    resetCamera(renderer, pSegment);
+    timer.restart();
+    renderFrame(renderer, view);
+    result.firstFrameMs = timer.elapsed();
+
+    if (!imageDir.isEmpty())
+    {
+        const QString imageName = QDir(imageDir).filePath(QFileInfo(fileName).completeBaseName() + ".png");
+        Image image = renderer.grabImage();
+        if (image.IsValid())
+            image.SavePNG(QDir::toNativeSeparators(imageName).toStdString());
+    }
+
+    result.staticFps = runCameraPath(renderer, pSegment, view, MbVector3D(0.0, 0.0, 0.0), frameCount);
+    result.orbitFps = runCameraPath(renderer, pSegment, view, MbVector3D(0.0, 0.0, 1.0), frameCount);
+    result.tumbleFps = runCameraPath(renderer, pSegment, view, MbVector3D(1.0, 0.0, 0.0), frameCount);
+
+    // the builder references the segments deleted below
+    delete view.pBuilder;
+    if (renderer.makeCurrent())
+    {
+        view.culler.release();
+        pRoot->RemoveSegment(pSegment);
+        delete pSegment;
+        renderer.doneCurrent();
+    }
+    ::ReleaseItem(pModel);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Math::SetMultithreadedMode(g_kDefaultMultithreadedMode);
+
+    // A build server has no display, the offscreen platform needs none.
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QCoreApplication::setApplicationName("RenderBenchmark");
+
+    Application vapp;
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offscreen build and render benchmark for the bundled models.");
+    parser.addHelpOption();
+    QCommandLineOption modelsOption("models", "Folder with .c3d models.", "dir", QDir(QCoreApplication::applicationDirPath()).filePath("Models"));
+    QCommandLineOption framesOption("frames", "Frames rendered along each camera path.", "count", "120");
+    QCommandLineOption sizeOption("size", "Framebuffer size.", "WxH", "1280x720");
+    QCommandLineOption imagesOption("images", "Save the first frame of each model as PNG into this folder.", "dir");
+    parser.addOption(modelsOption);
+    parser.addOption(framesOption);
+    parser.addOption(sizeOption);
+    parser.addOption(imagesOption);
+    parser.addPositionalArgument("models", "Model file names to run (all when omitted).", "[models...]");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (!QtVision::ActivateLicense(false))
+    {
+        err << "No valid C3D license." << endl;
+        return 1;
+    }
+
+    const int frameCount = qMax(1, parser.value(framesOption).toInt());
+    const QStringList sizeParts = parser.value(sizeOption).split('x');
+    const QSize size(sizeParts.value(0).toInt(), sizeParts.value(1).toInt());
+    if (size.isEmpty())
+    {
+        err << "Invalid framebuffer size " << parser.value(sizeOption) << endl;
+        return 1;
+    }
+
+    const QString imageDir = parser.value(imagesOption);
+    if (!imageDir.isEmpty())
+        QDir().mkpath(imageDir);
+
+    QDir modelsDir(parser.value(modelsOption));
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty())
+        files = modelsDir.entryList(QStringList() << "*.c3d", QDir::Files, QDir::Name);
+    if (files.isEmpty())
+    {
+        err << "No models in " << modelsDir.absolutePath() << endl;
+        return 2;
+    }
+
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8);
+    format.setSwapInterval(0);
+    QSurfaceFormat::setDefaultFormat(format);
+
+    QtOffscreenRenderer renderer(std::make_shared<GraphicsSceneEngine>(), size);
+    if (!renderer.isValid())
+    {
+        err << "Could not create an OpenGL context on the " << QGuiApplication::platformName() << " platform." << endl
+            << "The offscreen platform needs an EGL driver, e.g. LIBGL_ALWAYS_SOFTWARE=1 EGL_PLATFORM=surfaceless," << endl
+            << "or set QT_QPA_PLATFORM to a platform with OpenGL." << endl;
+        return 1;
+    }
+
+    out << "model\tload_ms\tbuild_ms\tfirst_frame_ms\tstatic_fps\torbit_fps\ttumble_fps" << endl;
+    int failed = 0;
+    for (const QString& name : files)
+    {
+        const QString fileName = modelsDir.filePath(name);
+        BenchmarkResult result;
+        if (!runModel(renderer, fileName, frameCount, imageDir, result))
+        {
+            err << "Could not load " << fileName << endl;
+            ++failed;
+            continue;
+        }
+        out << QFileInfo(fileName).fileName() << '\t'
+            << result.loadMs << '\t'
+            << result.buildMs << '\t'
+            << result.firstFrameMs << '\t'
+            << QString::number(result.staticFps, 'f', 1) << '\t'
+            << QString::number(result.orbitFps, 'f', 1) << '\t'
+            << QString::number(result.tumbleFps, 'f', 1) << endl;
+    }
+    return failed == 0 ? 0 : 3;
+}
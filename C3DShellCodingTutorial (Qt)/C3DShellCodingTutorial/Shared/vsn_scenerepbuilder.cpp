@@ -1,15 +1,33 @@
 ﻿#include <vsn_scenerepbuilder.h>
 
+#include <algorithm>
+
 #include <model.h>
 #include <instance.h>
 #include <assembly.h>
 #include <solid.h>
 #include <mesh.h>
+#include <mb_variables.h>
+#include <tool_multithreading.h>
+
+// Solids repeated at least this many times are merged into one mesh
+static const size_t c_batchThreshold = 32;
+// and only when a single copy is small, like fasteners are
+static const size_t c_batchMaxPoints = 2048;
+
+// Sags of the coarser levels of detail, relative to the diagonal of the solid;
+// level 0 is tessellated with Math::visualSag
+static const double c_levelSagRatios[] = { 0.0, 0.002, 0.008, 0.032 };
+static const size_t c_levelsMax = sizeof(c_levelSagRatios) / sizeof(c_levelSagRatios[0]);
+// A level is kept only when it has clearly fewer points than the previous one
+static const double c_levelPointsRatio = 0.6;
 
 /* SceneRepresentationBuilder */
 SceneRepresentationBuilder::SceneRepresentationBuilder(MbModel* pModel, SceneSegment* pTopSegment)
   : m_pModel( pModel )
   , m_pTopSegment( pTopSegment )
+  , m_batchThreshold( c_batchThreshold )
+  , m_levelsCount( 1 )
 {
 }
 
@@ -21,91 +39,543 @@ SceneRepresentationBuilder::~SceneRepresentationBuilder()
 }
 
 //------------------------------------------------------------------------------
-//
+// Build in three phases: collect unique solids and their instances, tessellate
+// the unique solids in parallel, then create the scene segments on this thread.
 // ---
 void SceneRepresentationBuilder::BuildScene()
 {
   if ( m_pModel == V_NULL || m_pTopSegment == V_NULL )
     return;
 
-  MbMatrix3D mx;
+  Prepare();
+
+  std::vector<MeshLevels> meshes( m_solids.size() );
+  Tessellate( meshes );
+
   SolidHash mapSolids;
+  CreateSegments( meshes, mapSolids );
+}
+
+//------------------------------------------------------------------------------
+// Collect the unique solids, their instances and their own bounding boxes.
+// ---
+void SceneRepresentationBuilder::Prepare()
+{
+  m_solids.clear();
+  m_instances.clear();
+  m_solidInstances.clear();
+  m_gabarits.clear();
+  m_batches.clear();
+  m_lodGroups.clear();
+  m_segmentIndex.clear();
+  if ( m_pModel == V_NULL )
+    return;
+
+  MbMatrix3D mx;
+  SolidIndex mapIndices;
+  ItemPath path;
   MbModel::ItemConstIterator drawIter( m_pModel->CBegin() );
   MbModel::ItemConstIterator drawEnd ( m_pModel->CEnd() );
   for ( ; drawIter != drawEnd; ++drawIter ) 
-    Build( *drawIter, m_pTopSegment, mx, mapSolids );
+    Collect( *drawIter, m_pTopSegment, mx, mapIndices, path );
+
+  m_solidInstances.resize( m_solids.size() );
+  for ( size_t i = 0, iCount = m_instances.size(); i < iCount; i++ )
+    m_solidInstances[m_instances[i].solidIndex].push_back( i );
+
+  m_gabarits.resize( m_solids.size() );
+  for ( size_t i = 0, iCount = m_solids.size(); i < iCount; i++ )
+    m_solids[i]->AddYourGabaritTo( m_gabarits[i] );
 }
 
 //------------------------------------------------------------------------------
 //
 // ---
-void SceneRepresentationBuilder::Build( const MbItem* pItem, SceneSegment* pParent, const MbMatrix3D& mx, SolidHash& mapSolids )
+static void ApplySolidColor( SceneSegment* pSegment, const MbSolid* pSolid )
 {
-  if ( pItem == V_NULL )
-    return;
+  if ( pSolid->IsColored() )
+  {
+    uint32 color = pSolid->GetColor();
+    pSegment->SetColorPresentationMaterial( Color((int)(color & 0xFF), (int)((color >> 8) & 0xFF), (int)((color >> 16) & 0xFF)) );
+  }
+}
 
-  if ( pItem->IsA() == st_Solid ) 
+//------------------------------------------------------------------------------
+// Box mesh of the cube with flat normals.
+// ---
+static MbMesh* CreateBoxMesh( const MbCube& cube )
+{
+  MbMesh* pMesh = new MbMesh();
+  pMesh->SetMeshType( st_Solid );
+  MbGrid* pGrid = pMesh->AddGrid();
+  if ( pGrid == V_NULL )
+    return pMesh;
+
+  const MbCartPoint3D& p0 = cube.pmin;
+  const MbCartPoint3D& p1 = cube.pmax;
+  const MbCartPoint3D corners[8] = {
+    MbCartPoint3D(p0.x, p0.y, p0.z), MbCartPoint3D(p1.x, p0.y, p0.z), MbCartPoint3D(p1.x, p1.y, p0.z), MbCartPoint3D(p0.x, p1.y, p0.z),
+    MbCartPoint3D(p0.x, p0.y, p1.z), MbCartPoint3D(p1.x, p0.y, p1.z), MbCartPoint3D(p1.x, p1.y, p1.z), MbCartPoint3D(p0.x, p1.y, p1.z) };
+  // corners of every face counterclockwise seen from outside
+  const uint faces[6][4] = { {0,3,2,1}, {4,5,6,7}, {0,1,5,4}, {2,3,7,6}, {1,2,6,5}, {0,4,7,3} };
+  const MbVector3D normals[6] = { MbVector3D(0,0,-1), MbVector3D(0,0,1), MbVector3D(0,-1,0), MbVector3D(0,1,0), MbVector3D(1,0,0), MbVector3D(-1,0,0) };
+
+  for ( uint f = 0; f < 6; f++ )
   {
-    MbSolid* pSolid = (MbSolid*)pItem; 
-    std::unordered_map<MbSolid*, SceneSegmentRef*>::const_iterator it = mapSolids.find(pSolid);
-    if (it != mapSolids.cend())
+    for ( uint k = 0; k < 4; k++ )
+      pGrid->AddPoint( corners[faces[f][k]], normals[f] );
+    pGrid->AddTriangle( 4 * f, 4 * f + 1, 4 * f + 2, true );
+    pGrid->AddTriangle( 4 * f, 4 * f + 2, 4 * f + 3, true );
+  }
+  return pMesh;
+}
+
+//------------------------------------------------------------------------------
+// Every instance gets a box of its solid, shared through one reference per solid.
+// ---
+void SceneRepresentationBuilder::CreateProxies()
+{
+  for ( size_t i = 0, iCount = m_solids.size(); i < iCount; i++ )
+  {
+    if ( m_gabarits[i].IsEmpty() )
+      continue;
+
+    SceneSegmentRef* pProxyRef = CreateReference( CreateBoxMesh(m_gabarits[i]) );
+    if ( pProxyRef == V_NULL )
+      continue;
+
+    for ( size_t index : m_solidInstances[i] )
     {
-      SceneSegmentRef* pSegmentRef = it->second;
-      SceneSegment* pNewSegment = new SceneSegment( new SceneSegmentData(pSegmentRef) );
-      pNewSegment->CreateRelativeMatrix( mx );
-      pParent->AddSegment(pNewSegment);
+      SolidInstance& instance = m_instances[index];
+      instance.pProxy = CreateInstanceSegment( instance, pProxyRef );
+      instance.pParent->AddSegment( instance.pProxy );
     }
-    else
+  }
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+MbCube SceneRepresentationBuilder::GetWorldGabarit( size_t solidIndex ) const
+{
+  MbCube gabarit;
+  for ( size_t index : m_solidInstances[solidIndex] )
+  {
+    MbCube cube( m_gabarits[solidIndex] );
+    cube.Transform( m_instances[index].matrix );
+    gabarit |= cube;
+  }
+  return gabarit;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+static size_t PointsCount( const MbItem* pMesh )
+{
+  if ( pMesh == V_NULL || pMesh->IsA() != st_Mesh )
+    return 0;
+  const MbMesh* pSolidMesh = (const MbMesh*)pMesh;
+  size_t pointsCount = 0;
+  for ( size_t i = 0, iCount = pSolidMesh->GridsCount(); i < iCount; i++ )
+    pointsCount += pSolidMesh->GetGrid(i)->PointsCount();
+  return pointsCount;
+}
+
+//------------------------------------------------------------------------------
+// The finest mesh first, then the coarser levels that save enough points.
+// Safe to call from several threads for different solids.
+// ---
+MeshLevels SceneRepresentationBuilder::TessellateSolid( size_t solidIndex ) const
+{
+  MeshLevels meshes;
+  const MbSolid* pSolid = m_solids[solidIndex];
+  MbItem* pMesh = CreateMesh( pSolid, StepData(Math::visualSag) );
+  meshes.push_back( { Math::visualSag, pMesh } );
+  // a batch is drawn at one level, its copies are small anyway
+  if ( pMesh == V_NULL || CanBatch(solidIndex, pMesh) )
+    return meshes;
+
+  size_t pointsCount = PointsCount( pMesh );
+  for ( size_t level = 1; level < m_levelsCount && level < c_levelsMax; level++ )
+  {
+    const double sag = LevelSag( solidIndex, level );
+    if ( sag <= meshes.back().sag )
+      continue;
+    MbItem* pLevelMesh = CreateMesh( pSolid, StepData(sag) );
+    const size_t levelPoints = PointsCount( pLevelMesh );
+    if ( levelPoints == 0 || levelPoints > c_levelPointsRatio * pointsCount )
+    {
+      if ( pLevelMesh != V_NULL )
+        ::DeleteItem( pLevelMesh );
+      continue;
+    }
+    meshes.push_back( { sag, pLevelMesh } );
+    pointsCount = levelPoints;
+  }
+  return meshes;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+void SceneRepresentationBuilder::ReleaseMeshes( MeshLevels& meshes )
+{
+  for ( const MeshLevel& level : meshes )
+    if ( level.pMesh != V_NULL )
+      ::DeleteItem( level.pMesh );
+  meshes.clear();
+}
+
+//------------------------------------------------------------------------------
+// Replace the proxies of the solid with its meshes. Takes the ownership of the meshes.
+// An instance with several levels gets a segment per level under its own segment.
+// Returns the shared reference of the finest level, V_NULL when the instances were batched.
+// ---
+SceneSegmentRef* SceneRepresentationBuilder::ApplyMesh( size_t solidIndex, MeshLevels& meshes )
+{
+  for ( size_t index : m_solidInstances[solidIndex] )
+  {
+    SolidInstance& instance = m_instances[index];
+    if ( instance.pProxy != V_NULL )
+    {
+      instance.pParent->RemoveSegment( instance.pProxy );
+      VSN_DELETE_AND_NULL( instance.pProxy );
+    }
+  }
+
+  if ( meshes.empty() )
+    return V_NULL;
+
+  MbItem* pMesh = meshes.front().pMesh;
+  if ( CanBatch(solidIndex, pMesh) )
+  {
+    meshes.front().pMesh = V_NULL;
+    ReleaseMeshes( meshes );
+    ::AddRefItem( pMesh );
+    CreateBatches( solidIndex, *(const MbMesh*)pMesh );
+    ::ReleaseItem( pMesh );
+    return V_NULL;
+  }
+
+  std::vector<SceneSegmentRef*> levelRefs;
+  std::vector<double> sags;
+  for ( const MeshLevel& level : meshes )
+  {
+    if ( SceneSegmentRef* pLevelRef = CreateReference(level.pMesh) )
+    {
+      levelRefs.push_back( pLevelRef );
+      sags.push_back( level.sag );
+    }
+  }
+  meshes.clear();
+  if ( levelRefs.empty() )
+    return V_NULL;
+
+  const MbSolid* pSolid = m_solids[solidIndex];
+  for ( size_t index : m_solidInstances[solidIndex] )
+  {
+    SolidInstance& instance = m_instances[index];
+    if ( levelRefs.size() == 1 )
+    {
+      instance.pSegment = CreateInstanceSegment( instance, levelRefs.front() );
+      instance.pParent->AddSegment( instance.pSegment );
+      m_segmentIndex[instance.pSegment->GetUniqueKey().GetKey()] = { index, false };
+      continue;
+    }
+
+    LodGroup group;
+    group.instance = index;
+    group.sags = sags;
+    group.gabarit = m_gabarits[solidIndex];
+    group.gabarit.Transform( instance.matrix );
+    group.level = -1;
+
+    instance.pSegment = new SceneSegment();
+    instance.pSegment->CreateRelativeMatrix( instance.matrix );
+    for ( SceneSegmentRef* pLevelRef : levelRefs )
+    {
+      SceneSegment* pLevelSegment = new SceneSegment( new SceneSegmentData(pLevelRef) );
+      ApplySolidColor( pLevelSegment, pSolid );
+      instance.pSegment->AddSegment( pLevelSegment );
+      group.segments.push_back( pLevelSegment );
+      m_segmentIndex[pLevelSegment->GetUniqueKey().GetKey()] = { index, false };
+    }
+    instance.pParent->AddSegment( instance.pSegment );
+    m_lodGroups.push_back( group );
+  }
+  return levelRefs.front();
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+bool SceneRepresentationBuilder::CanBatch( size_t solidIndex, const MbItem* pMesh ) const
+{
+  if ( m_batchThreshold == 0 || m_solidInstances[solidIndex].size() < m_batchThreshold )
+    return false;
+  if ( pMesh == V_NULL || pMesh->IsA() != st_Mesh )
+    return false;
+
+  const MbMesh* pSolidMesh = (const MbMesh*)pMesh;
+  if ( pSolidMesh->PolygonsCount() != 0 || pSolidMesh->ApexesCount() != 0 )
+    return false;
+  return PointsCount( pMesh ) <= c_batchMaxPoints;
+}
+
+//------------------------------------------------------------------------------
+// Copies of the mesh are transformed into a single mesh per parent segment; the
+// grids keep their primitive names, so a pick still tells the face of the part.
+// ---
+void SceneRepresentationBuilder::CreateBatches( size_t solidIndex, const MbMesh& mesh )
+{
+  std::unordered_map<SceneSegment*, std::vector<size_t>> groups;
+  for ( size_t index : m_solidInstances[solidIndex] )
+    groups[m_instances[index].pParent].push_back( index );
+
+  for ( const auto& group : groups )
+  {
+    InstanceBatch batch;
+    batch.pSegment = V_NULL;
+    MbMesh* pBatchMesh = new MbMesh();
+    pBatchMesh->SetMeshType( mesh.GetMeshType() );
+
+    MbCartPoint3D point;
+    MbVector3D normal;
+    for ( size_t index : group.second )
     {
-      MbMesh* pMesh = V_NULL;
-      if ( MbItem* pItemMesh = CreateMesh(pSolid) )
+      const MbMatrix3D& mx = m_instances[index].matrix;
+      batch.instances.push_back( index );
+      batch.firstBodies.push_back( pBatchMesh->GridsCount() );
+      for ( size_t i = 0, iCount = mesh.GridsCount(); i < iCount; i++ )
       {
-        ::AddRefItem( pItemMesh );
-        if ( pItemMesh->IsA() == st_Mesh )
-          pMesh = (MbMesh*)pItemMesh;
-        else
+        const MbGrid* pSource = mesh.GetGrid(i);
+        MbGrid* pGrid = pBatchMesh->AddGrid();
+        if ( pSource == V_NULL || pGrid == V_NULL )
+          continue;
+        pGrid->SetPrimitiveName( pSource->GetPrimitiveName() );
+        pGrid->SetPrimitiveType( pSource->GetPrimitiveType() );
+        pGrid->ReservePointsNormals( pSource->PointsCount() );
+        for ( size_t j = 0, jCount = pSource->PointsCount(); j < jCount; j++ )
+        {
+          pSource->GetPoint( j, point );
+          pSource->GetNormal( j, normal );
+          point.Transform( mx );
+          normal.Transform( mx );
+          normal.Normalize();
+          pGrid->AddPoint( point, normal );
+        }
+        uint i0 = 0, i1 = 0, i2 = 0, i3 = 0;
+        for ( size_t j = 0, jCount = pSource->TrianglesCount(); j < jCount; j++ )
+          if ( pSource->GetTriangleIndex(j, i0, i1, i2) )
+            pGrid->AddTriangle( i0, i1, i2, true );
+        for ( size_t j = 0, jCount = pSource->QuadranglesCount(); j < jCount; j++ )
         {
-          ::ReleaseItem( pItemMesh );
-          return;
+          if ( pSource->GetQuadrangleIndex(j, i0, i1, i2, i3) )
+          {
+            pGrid->AddTriangle( i0, i1, i2, true );
+            pGrid->AddTriangle( i0, i2, i3, true );
+          }
         }
       }
+    }
 
-      if ( pMesh != V_NULL )
-      {
-        SceneSegmentRef* pSegmentRef = new SceneSegmentRef( SolidObject::CreateGeometryRep3D(pMesh) );
-        SceneSegment* pNewSegment = new SceneSegment( new SceneSegmentData(pSegmentRef) );
-        pNewSegment->CreateRelativeMatrix( mx );
-        pParent->AddSegment(pNewSegment);
+    SceneSegmentRef* pSegmentRef = CreateReference( pBatchMesh );
+    if ( pSegmentRef == V_NULL )
+      continue;
+    batch.pSegment = new SceneSegment( new SceneSegmentData(pSegmentRef) );
+    ApplySolidColor( batch.pSegment, m_solids[solidIndex] );
+    group.first->AddSegment( batch.pSegment );
+    m_segmentIndex[batch.pSegment->GetUniqueKey().GetKey()] = { m_batches.size(), true };
+    m_batches.push_back( batch );
+  }
+}
 
-        mapSolids.insert(std::pair<MbSolid*, SceneSegmentRef*>(pSolid, pSegmentRef));
-        ::ReleaseItem( pMesh );
-      }
+//------------------------------------------------------------------------------
+// Find the model items leading to the picked instance; indexBody is only used
+// for batched instances.
+// ---
+bool SceneRepresentationBuilder::FindInstancePath( const NodeKey& key, int indexBody, ItemPath& path ) const
+{
+  SegmentIndex::const_iterator found = m_segmentIndex.find( key.GetKey() );
+  if ( found == m_segmentIndex.end() )
+    return false;
+
+  const SegmentOwner& owner = found->second;
+  if ( !owner.isBatch )
+  {
+    path = m_instances[owner.index].path;
+    return true;
+  }
+
+  const InstanceBatch& batch = m_batches[owner.index];
+  if ( indexBody < 0 || batch.firstBodies.empty() )
+    return false;
+  std::vector<size_t>::const_iterator it = std::upper_bound( batch.firstBodies.begin(), batch.firstBodies.end(), (size_t)indexBody );
+  path = m_instances[batch.instances[(it - batch.firstBodies.begin()) - 1]].path;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// The builder only knows solids, instances and assemblies
+// ---
+static bool IsSupportedItem( const MbItem* pItem )
+{
+  if ( pItem == V_NULL )
+    return true;
+  if ( pItem->IsA() == st_Solid )
+    return true;
+  if ( pItem->IsA() == st_Instance )
+    return IsSupportedItem( ((const MbInstance*)pItem)->GetItem() );
+  if ( pItem->IsA() == st_Assembly )
+  {
+    const MbAssembly* pAssembly = (const MbAssembly*)pItem; 
+    for ( size_t i = 0, iCount = pAssembly->ItemsCount(); i < iCount; i++ ) 
+      if ( !IsSupportedItem( pAssembly->GetItem(i) ) )
+        return false;
+    return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+bool SceneRepresentationBuilder::IsSupported( const MbModel* pModel )
+{
+  if ( pModel == V_NULL )
+    return false;
+
+  MbModel::ItemConstIterator drawIter( pModel->CBegin() );
+  MbModel::ItemConstIterator drawEnd ( pModel->CEnd() );
+  for ( ; drawIter != drawEnd; ++drawIter ) 
+    if ( !IsSupportedItem( *drawIter ) )
+      return false;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+void SceneRepresentationBuilder::Collect( const MbItem* pItem, SceneSegment* pParent, const MbMatrix3D& mx, SolidIndex& mapSolids, ItemPath& path )
+{
+  if ( pItem == V_NULL )
+    return;
+
+  path.push_back( pItem );
+
+  if ( pItem->IsA() == st_Solid ) 
+  {
+    const MbSolid* pSolid = (const MbSolid*)pItem; 
+    SolidIndex::const_iterator it = mapSolids.find(pSolid);
+    size_t index = 0;
+    if (it != mapSolids.cend())
+      index = it->second;
+    else
+    {
+      index = m_solids.size();
+      m_solids.push_back(pSolid);
+      mapSolids.insert(std::pair<const MbSolid*, size_t>(pSolid, index));
     }
+    m_instances.push_back({ index, pParent, mx, V_NULL, V_NULL, path });
   }
   else if ( pItem->IsA() == st_Instance ) 
   {
     const MbInstance* pInstance = (const MbInstance*)pItem; 
-    Build( pInstance->GetItem(), pParent, pInstance->GetPlacement().GetMatrixFrom() * mx, mapSolids );
+    Collect( pInstance->GetItem(), pParent, pInstance->GetPlacement().GetMatrixFrom() * mx, mapSolids, path );
   }
   else if ( pItem->IsA() == st_Assembly ) 
   {
     const MbAssembly* pAssembly = (const MbAssembly*)pItem; 
     for ( size_t i = 0, iCount = pAssembly->ItemsCount(); i < iCount; i++ ) 
-      Build( pAssembly->GetItem(i), pParent, mx, mapSolids );
+      Collect( pAssembly->GetItem(i), pParent, mx, mapSolids, path );
   }
+  path.pop_back();
+}
+
+//------------------------------------------------------------------------------
+// Solids differ a lot in cost, so iterations are handed out dynamically to idle threads.
+// ---
+void SceneRepresentationBuilder::Tessellate( std::vector<MeshLevels>& meshes ) const
+{
+  const ptrdiff_t count = (ptrdiff_t)m_solids.size();
+  bool useParallel = count > 1 && Math::CheckMultithreadedMode( mtm_Items );
+
+  ENTER_PARALLEL( useParallel );
+  #pragma omp parallel for schedule(dynamic) if (useParallel)
+  for ( ptrdiff_t i = 0; i < count; ++i )
+    meshes[i] = TessellateSolid( (size_t)i );
+  EXIT_PARALLEL( useParallel );
 }
 
 //------------------------------------------------------------------------------
 //
 // ---
-MbItem* SceneRepresentationBuilder::CreateMesh( const MbSolid* pSolid )
+void SceneRepresentationBuilder::CreateSegments( std::vector<MeshLevels>& meshes, SolidHash& mapSolids )
+{
+  for ( size_t i = 0, iCount = meshes.size(); i < iCount; i++ )
+  {
+    if ( SceneSegmentRef* pSegmentRef = ApplyMesh(i, meshes[i]) )
+      mapSolids.insert(std::pair<MbSolid*, SceneSegmentRef*>(const_cast<MbSolid*>(m_solids[i]), pSegmentRef));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Takes the ownership of the mesh.
+// ---
+SceneSegmentRef* SceneRepresentationBuilder::CreateReference( MbItem* pItemMesh ) const
+{
+  if ( pItemMesh == V_NULL )
+    return V_NULL;
+
+  SceneSegmentRef* pSegmentRef = V_NULL;
+  ::AddRefItem( pItemMesh );
+  if ( pItemMesh->IsA() == st_Mesh )
+    pSegmentRef = new SceneSegmentRef( SolidObject::CreateGeometryRep3D((MbMesh*)pItemMesh) );
+  ::ReleaseItem( pItemMesh );
+  return pSegmentRef;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+SceneSegment* SceneRepresentationBuilder::CreateInstanceSegment( const SolidInstance& instance, SceneSegmentRef* pSegmentRef ) const
+{
+  SceneSegment* pNewSegment = new SceneSegment( new SceneSegmentData(pSegmentRef) );
+  pNewSegment->CreateRelativeMatrix( instance.matrix );
+  ApplySolidColor( pNewSegment, m_solids[instance.solidIndex] );
+  return pNewSegment;
+}
+
+//------------------------------------------------------------------------------
+//
+// ---
+MbItem* SceneRepresentationBuilder::CreateMesh( const MbSolid* pSolid, const MbStepData& stepData ) const
 {
   MbRegDuplicate* iReg = V_NULL;
   const MbFormNote note;
-  if ( MbItem* pItem = pSolid->CreateMesh( MbStepData(ist_SpaceStep, Math::visualSag), note, iReg) )
+  if ( MbItem* pItem = pSolid->CreateMesh( stepData, note, iReg) )
     return pItem;
   return V_NULL;
 }
 
+//------------------------------------------------------------------------------
+//
+// ---
+MbStepData SceneRepresentationBuilder::StepData( double sag )
+{
+  return MbStepData( ist_SpaceStep, sag );
+}
+
+//------------------------------------------------------------------------------
+// Never finer than Math::visualSag, so a tiny solid keeps a single level.
+// ---
+double SceneRepresentationBuilder::LevelSag( size_t solidIndex, size_t level ) const
+{
+  if ( level == 0 || level >= c_levelsMax || m_gabarits[solidIndex].IsEmpty() )
+    return Math::visualSag;
+  return std::max( Math::visualSag, c_levelSagRatios[level] * m_gabarits[solidIndex].GetDiagonal() );
+}
+
 
 
@@ -2,6 +2,7 @@
 #define __VSN_SCENEREPBUILDER_H
 
 #include <unordered_map>
+#include <vector>
 #include <vsn_vision.h>
 
 // en
@@ -15,9 +16,64 @@
 // NO TRANSLATION.
 
 class MbItem;
+class MbMesh;
 class MbModel;
 class MbSolid;
+class MbStepData;
 typedef std::unordered_map<MbSolid*, SceneSegmentRef*> SolidHash;
+typedef std::unordered_map<const MbSolid*, size_t> SolidIndex;
+typedef std::vector<const MbItem*> ItemPath; // from a model item down to the solid
+
+/* MeshLevel */
+// Mesh of a solid tessellated with the given sag.
+struct MeshLevel
+{
+  double  sag;
+  MbItem* pMesh;
+};
+typedef std::vector<MeshLevel> MeshLevels; // the finest first
+
+/* SolidInstance */
+struct SolidInstance
+{
+  size_t        solidIndex; // index into the unique solids
+  SceneSegment* pParent;
+  MbMatrix3D    matrix;
+  SceneSegment* pProxy;     // bounding box shown until the mesh is ready
+  SceneSegment* pSegment;   // own segment, V_NULL when drawn by a batch
+  ItemPath      path;
+};
+
+/* InstanceBatch */
+// Instances of one solid merged into a single mesh, so they take one draw call.
+// Body i of the mesh belongs to the instance whose firstBodies entry is the last one <= i.
+struct InstanceBatch
+{
+  SceneSegment*       pSegment;
+  std::vector<size_t> instances;
+  std::vector<size_t> firstBodies;
+};
+
+/* LodGroup */
+// Instance drawn with several meshes of decreasing detail, segments[i] is the one
+// tessellated with sags[i]. Only the segment of the current level is meant to be shown.
+struct LodGroup
+{
+  size_t                     instance;
+  std::vector<SceneSegment*> segments;
+  std::vector<double>        sags;
+  MbCube                     gabarit; // of the instance in the model space
+  int                        level;   // -1 until a level is chosen
+};
+
+/* SegmentOwner */
+// What a segment made by the builder draws: an instance or a batch of them.
+struct SegmentOwner
+{
+  size_t index;   // into the instances or the batches
+  bool   isBatch;
+};
+typedef std::unordered_map<uint64, SegmentOwner> SegmentIndex; // by the segment key
 
 /* BuilderRepresentation */
 class SceneRepresentationBuilder
@@ -27,14 +83,47 @@ public:
   virtual ~SceneRepresentationBuilder();
 public:
   void BuildScene();
+  static bool IsSupported( const MbModel* pModel );
+
+public: // progressive building, the meshes are applied one solid at a time
+  void    Prepare();
+  void    CreateProxies();
+  size_t  GetSolidsCount() const { return m_solids.size(); }
+  MbCube  GetWorldGabarit( size_t solidIndex ) const;
+  MeshLevels TessellateSolid( size_t solidIndex ) const;
+  SceneSegmentRef* ApplyMesh( size_t solidIndex, MeshLevels& meshes );
+  static void ReleaseMeshes( MeshLevels& meshes );
+
+public:
+  void SetBatchThreshold( size_t count ) { m_batchThreshold = count; }
+  void SetLevelsOfDetail( size_t count ) { m_levelsCount = count; }
+  std::vector<LodGroup>& GetLodGroups() { return m_lodGroups; }
+  bool FindInstancePath( const NodeKey& key, int indexBody, ItemPath& path ) const;
 
 protected:
-  void Build( const MbItem* pItem, SceneSegment* pParent, const MbMatrix3D& mx, SolidHash& mapSolids );
-  MbItem* CreateMesh( const MbSolid* pSolid );
+  void Collect( const MbItem* pItem, SceneSegment* pParent, const MbMatrix3D& mx, SolidIndex& mapSolids, ItemPath& path );
+  void Tessellate( std::vector<MeshLevels>& meshes ) const;
+  void CreateSegments( std::vector<MeshLevels>& meshes, SolidHash& mapSolids );
+  virtual MbItem* CreateMesh( const MbSolid* pSolid, const MbStepData& stepData ) const;
+  static MbStepData StepData( double sag );
+  double LevelSag( size_t solidIndex, size_t level ) const;
+  SceneSegmentRef* CreateReference( MbItem* pMesh ) const;
+  SceneSegment* CreateInstanceSegment( const SolidInstance& instance, SceneSegmentRef* pSegmentRef ) const;
+  bool CanBatch( size_t solidIndex, const MbItem* pMesh ) const;
+  void CreateBatches( size_t solidIndex, const MbMesh& mesh );
 
 private:
   MbModel* m_pModel;
   SceneSegment* m_pTopSegment;
+  std::vector<const MbSolid*> m_solids;
+  std::vector<SolidInstance> m_instances;
+  std::vector<std::vector<size_t>> m_solidInstances;
+  std::vector<MbCube> m_gabarits;
+  std::vector<InstanceBatch> m_batches;
+  std::vector<LodGroup> m_lodGroups;
+  SegmentIndex m_segmentIndex;
+  size_t m_batchThreshold;
+  size_t m_levelsCount;
 };
 
 #endif /* __VSN_SCENEREPBUILDER_H */
@@ -198,11 +198,7 @@ void CDispFuncDoc::OnSetparam()
 	if (Dlg.DoModal() == IDOK) {
 		m_CPointColor = Dlg.m_CMFCPointColor;
 		m_CLineColor = Dlg.m_CMFCLineColor;
-		delete[] m_dPointX;
-		delete[] m_dPointY;
-		m_iNum = Dlg.m_iSPArrayXYSize;
-		m_dPointX = new double[m_iNum];
-		m_dPointY = new double[m_iNum];
+		SetNodesCount(Dlg.m_iSPArrayXYSize);
 		for (int i = 0; i < m_iNum; i++)
 		{
 			m_dPointX[i] = Dlg.m_cSPPointX[i];
@@ -216,11 +212,7 @@ void CDispFuncDoc::OnSetparam()
 
 void CDispFuncDoc::OnForinsertfunction()
 {
-
-	delete[] m_dPointX;
-	delete[] m_dPointY;
-	m_dPointX = new double[m_iNum];
-	m_dPointY = new double[m_iNum];
+	SetNodesCount(m_iFonctNum);
 		double j = FirstPoint;
 		for (int i = 0; i < m_iNum; i++, j += m_dStep)
 		{
@@ -228,6 +220,8 @@ void CDispFuncDoc::OnForinsertfunction()
 			m_dPointY[i] = Fonct(m_CInputSTRView, m_dPointX[i]);
 		}
 	GetMinMax();
+	if (m_bAdaptivePlot && AdaptiveFonct(m_CInputSTRView, FirstPoint, FirstPoint + (m_iFonctNum - 1) * m_dStep))
+		GetMinMax();
 	UpdateAllViews(NULL);;
 }
 
@@ -244,6 +238,51 @@ double CDispFuncDoc::Fonct(CString Cstr, double x)
 		return 0;
 	}
 }
+// Fills m_cCurveX/m_cCurveY by interval-driven subdivision on [a, b], for the polyline mode
+bool CDispFuncDoc::AdaptiveFonct(CString Cstr, double a, double b)
+{
+	// same Coeff as CDispFuncView::OnDraw, taken from the nodes; one pixel along the longer side
+	double One = max(Xmax, abs(Xmin));
+	double Two = max(Ymax, abs(Ymin));
+	double Coeff = max(One, Two);
+	int iPlotSize = max(m_iPlotWidth, m_iPlotHeight);
+	if (iPlotSize <= 50 || !(Coeff > 0))
+		return false;
+	double pixel = 2 * Coeff / (iPlotSize - 50);
+
+	std::vector<double> xs, ys;
+	try {
+		Parser p(Cstr);
+		Expression e = p.parse();
+		PlotAdaptive(p, e, a, b, pixel, xs, ys);
+	}
+	catch (std::exception&) {
+		return false;
+	}
+	if (xs.empty())
+		return false;
+
+	m_cCurveX.SetSize(xs.size());
+	m_cCurveY.SetSize(ys.size());
+	for (size_t i = 0; i < xs.size(); i++)
+	{
+		m_cCurveX[i] = xs[i];
+		m_cCurveY[i] = ys[i];
+	}
+	return true;
+}
+
+void CDispFuncDoc::SetNodesCount(int iNum)
+{
+	delete[] m_dPointX;
+	delete[] m_dPointY;
+	m_iNum = iNum;
+	m_dPointX = new double[m_iNum];
+	m_dPointY = new double[m_iNum];
+	m_cCurveX.RemoveAll();
+	m_cCurveY.RemoveAll();
+}
+
 void CDispFuncDoc::GetMinMax()
 {
 	Xmax = m_dPointX[0];
@@ -257,6 +296,13 @@ void CDispFuncDoc::GetMinMax()
 		if (Xmin > m_dPointX[i]) Xmin = m_dPointX[i];
 		if (Ymin > m_dPointY[i]) Ymin = m_dPointY[i];
 	}
+	for (INT_PTR i = 0; i < m_cCurveX.GetSize(); i++)
+	{
+		if (Xmax < m_cCurveX[i]) Xmax = m_cCurveX[i];
+		if (Ymax < m_cCurveY[i]) Ymax = m_cCurveY[i];
+		if (Xmin > m_cCurveX[i]) Xmin = m_cCurveX[i];
+		if (Ymin > m_cCurveY[i]) Ymin = m_cCurveY[i];
+	}
 }
 void CDispFuncDoc::GetCircle()
 {
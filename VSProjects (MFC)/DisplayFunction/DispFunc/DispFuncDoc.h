@@ -28,6 +28,8 @@ public:
 	double Xmax=0, Ymax = 0;
 	double Xmin = 0, Ymin = 0;
 	void GetMinMax();
+	// room for iNum new nodes, the polyline of the old function is dropped
+	void SetNodesCount(int iNum);
 
 	void GetCircle();
 	double CalcFunR(double r, double x, double y);
@@ -47,6 +49,14 @@ public:
 	//4
 	CString m_CInputSTRView;
 	double Fonct(CString Cstr, double x);
+	bool m_bAdaptivePlot = true;
+	int m_iFonctNum = FirstSize;
+	int m_iPlotWidth = 0;
+	int m_iPlotHeight = 0;
+	// polyline of the function, the nodes in m_dPointX stay evenly spaced for LaGrange
+	CArray<double, double>m_cCurveX;
+	CArray<double, double>m_cCurveY;
+	bool AdaptiveFonct(CString Cstr, double a, double b);
 	// 5
 	COLORREF m_CPointColor = RGB(0, 255, 0);
 	COLORREF m_CLineColor = RGB(255, 0, 0);
@@ -109,11 +109,7 @@ void CDispFuncParamView::OnBnClickedButton4()
 		m_x.Add(m_dSeta + m_dSetr*cos(angle) + (rand() % 200 - 100) / 1000);
 		m_y.Add(m_dSetb + m_dSetr*sin(angle) + (rand() % 200 - 100) / 1000);
 	}
-	delete[] pDoc->m_dPointX;
-	delete[] pDoc->m_dPointY;
-	pDoc->m_iNum = m_iNumberP;
-	pDoc->m_dPointX = new double[pDoc->m_iNum];
-	pDoc->m_dPointY = new double[pDoc->m_iNum];
+	pDoc->SetNodesCount(m_iNumberP);
 	for (int i = 0; i < pDoc->m_iNum; i++)
 	{
 		pDoc->m_dPointX[i] = m_x[i];
@@ -202,11 +198,7 @@ void CDispFuncParamView::OnBnClickedButton2()
 		//m_CMFC_points.SetColor(m_CMFCPointColor);
 		//m_CMFC_lines.SetColor(m_CMFCLineColor);
 		UpdateData(FALSE);
-		delete[] pDoc->m_dPointX;
-		delete[] pDoc->m_dPointY;
-		pDoc->m_iNum = m_iSPArrayXYSize;
-		pDoc->m_dPointX = new double[pDoc->m_iNum];
-		pDoc->m_dPointY = new double[pDoc->m_iNum];
+		pDoc->SetNodesCount(m_iSPArrayXYSize);
 		for (int i = 0; i < pDoc->m_iNum; i++)
 		{
 			pDoc->m_dPointX[i] = m_cSPPointX[i];
@@ -232,6 +224,7 @@ void CDispFuncParamView::OnBnClickedButton1()
 		return;
 	UpdateData();
 	pDoc->m_iNum = m_dIStrArrSize;
+	pDoc->m_iFonctNum = m_dIStrArrSize;
 	pDoc->m_iDocChose = m_iChose;
 	pDoc->m_CInputSTRView = m_CStr;
 	pDoc->OnForinsertfunction();
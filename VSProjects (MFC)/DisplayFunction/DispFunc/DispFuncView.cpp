@@ -74,6 +74,8 @@ void CDispFuncView::OnDraw(CDC* pDC)
 		pDoc->m_iOriginVertical = pRECT.bottom;
 		IsOrigParam = true;
 	}
+	pDoc->m_iPlotWidth = pRECT.right;
+	pDoc->m_iPlotHeight = pRECT.bottom;
 	
 	double Coeff;
 	double One, Two;
@@ -103,7 +105,13 @@ void CDispFuncView::OnDraw(CDC* pDC)
 			pDC->LineTo(PosX(pDoc->m_dLagrangeX[i + 1] * ZoomX), PosY(pDoc->m_dLagrangeY[i + 1] * ZoomY));
 		}
 	}
-	if (pDoc->m_iDocChose == 1) {
+	if (pDoc->m_iDocChose == 1 && pDoc->m_cCurveX.GetSize() > 1) {
+		SelectObject(*pDC, RPEN);
+		pDC->MoveTo(PosX(pDoc->m_cCurveX[0] * ZoomX), PosY(pDoc->m_cCurveY[0] * ZoomY));
+		for (INT_PTR i = 1; i < pDoc->m_cCurveX.GetSize(); i++)
+			pDC->LineTo(PosX(pDoc->m_cCurveX[i] * ZoomX), PosY(pDoc->m_cCurveY[i] * ZoomY));
+	}
+	else if (pDoc->m_iDocChose == 1) {
 		SelectObject(*pDC, RPEN);
 		for (int i = 0; i < pDoc->m_iNum - 1; i++)
 		{
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Parser.h"
 #include <sstream>
+#include <limits>
+#include <algorithm>
 #define PI 4.0*atan(1.0)
 
 std::string Parser::parse_token() {
@@ -15,6 +17,10 @@ std::string Parser::parse_token() {
 	}
 
 	if (*input == 'x') {
+		if (SymbolicX) {
+			input++;
+			return "x";
+		}
 		if (ValueX >= 0) {
 			std::ostringstream os;
 			os << ValueX;
@@ -61,7 +67,7 @@ Expression Parser::parse_simple_expression() {
 		return result;
 	}
 
-	if (std::isdigit(token[0]))
+	if (std::isdigit(token[0]) || token == "x")
 		return Expression(token);
 
 	return Expression(token, parse_simple_expression());
@@ -133,8 +139,176 @@ double Parser::eval(const Expression& e) {
 	}
 
 	case 0:
+		if (e.token == "x") return ValueX;
 		return strtod(e.token.c_str(), nullptr);
 	}
 
 	throw std::runtime_error("Unknown expression type");
 }
+
+static const double Inf = std::numeric_limits<double>::infinity();
+static const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+static Interval whole() {
+	return Interval(-Inf, Inf);
+}
+
+static Interval hull(double a, double b, double c, double d) {
+	if (std::isnan(a) || std::isnan(b) || std::isnan(c) || std::isnan(d))
+		return whole();
+	return Interval(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+}
+
+// true if some c + k*period lies in [lo, hi]
+static bool contains_period(const Interval& a, double c, double period) {
+	double k = ceil((a.lo - c) / period);
+	return c + k * period <= a.hi;
+}
+
+static Interval imul(const Interval& a, const Interval& b) {
+	return hull(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi);
+}
+
+static Interval idiv(const Interval& a, const Interval& b) {
+	if (b.lo <= 0 && b.hi >= 0)
+		return whole();
+	return imul(a, Interval(1.0 / b.hi, 1.0 / b.lo));
+}
+
+static Interval ipow(const Interval& a, const Interval& b) {
+	if (b.lo == b.hi && b.lo == floor(b.lo) && fabs(b.lo) < 1e9) {
+		double n = b.lo;
+		if (n < 0)
+			return idiv(Interval(1.0), ipow(a, Interval(-n)));
+		double lo = pow(a.lo, n), hi = pow(a.hi, n);
+		if (fmod(n, 2.0) != 0)
+			return Interval(lo, hi);
+		if (a.lo <= 0 && a.hi >= 0)
+			return Interval(0, std::max(lo, hi));
+		return Interval(std::min(lo, hi), std::max(lo, hi));
+	}
+	// pow(x, y) is monotone in each argument for x > 0
+	if (a.lo > 0)
+		return hull(pow(a.lo, b.lo), pow(a.lo, b.hi), pow(a.hi, b.lo), pow(a.hi, b.hi));
+	return whole();
+}
+
+static bool fits_int(const Interval& a) {
+	return std::isfinite(a.lo) && std::isfinite(a.hi)
+		&& a.lo >= std::numeric_limits<int>::min() && a.hi <= std::numeric_limits<int>::max();
+}
+
+static Interval isin(const Interval& a) {
+	if (a.width() >= 2 * (PI))
+		return Interval(-1, 1);
+	double lo = std::min(sin(a.lo), sin(a.hi));
+	double hi = std::max(sin(a.lo), sin(a.hi));
+	if (contains_period(a, (PI) / 2, 2 * (PI))) hi = 1;
+	if (contains_period(a, -(PI) / 2, 2 * (PI))) lo = -1;
+	return Interval(lo, hi);
+}
+
+Interval Parser::eval(const Expression& e, const Interval& x) {
+	switch (e.args.size()) {
+	case 2: {
+		auto a = eval(e.args[0], x);
+		auto b = eval(e.args[1], x);
+		if (e.token == "+") return Interval(a.lo + b.lo, a.hi + b.hi);
+		if (e.token == "-") return Interval(a.lo - b.hi, a.hi - b.lo);
+		if (e.token == "*") return imul(a, b);
+		if (e.token == "/") return idiv(a, b);
+		if (e.token == "^") return ipow(a, b);
+		if (e.token == "mod") {
+			// the casts below are only defined for finite values inside the int range
+			if (!fits_int(a) || !fits_int(b))
+				return whole();
+			if ((int)a.lo == (int)a.hi && (int)b.lo == (int)b.hi && (int)b.lo != 0)
+				return Interval((int)a.lo % (int)b.lo);
+			double m = std::max(fabs(b.lo), fabs(b.hi));
+			return Interval(a.lo >= 0 ? 0 : 1 - m, a.hi <= 0 ? 0 : m - 1);
+		}
+		throw std::runtime_error("Unknown binary operator");
+	}
+
+	case 1: {
+		auto a = eval(e.args[0], x);
+		if (e.token == "+") return a;
+		if (e.token == "-") return Interval(-a.hi, -a.lo);
+		if (e.token == "sqrt") {
+			if (a.hi < 0) return Interval(NaN, NaN);
+			return Interval(sqrt(std::max(a.lo, 0.0)), sqrt(a.hi));
+		}
+		if (e.token == "abs") {
+			if (a.lo >= 0) return a;
+			if (a.hi <= 0) return Interval(-a.hi, -a.lo);
+			return Interval(0, std::max(-a.lo, a.hi));
+		}
+		if (e.token == "sin") return isin(a);
+		if (e.token == "cos") return isin(Interval(a.lo + (PI) / 2, a.hi + (PI) / 2));
+		if (e.token == "arcsin" || e.token == "arccos") {
+			if (a.hi < -1 || a.lo > 1) return Interval(NaN, NaN);
+			double lo = asin(std::max(a.lo, -1.0)), hi = asin(std::min(a.hi, 1.0));
+			if (e.token == "arcsin") return Interval(lo, hi);
+			return Interval((PI) / 2 - hi, (PI) / 2 - lo);
+		}
+		if (e.token == "tg") {
+			if (a.width() >= (PI) || contains_period(a, (PI) / 2, (PI))) return whole();
+			return Interval(tan(a.lo), tan(a.hi));
+		}
+		if (e.token == "ctg") {
+			if (a.width() >= (PI) || contains_period(a, 0, (PI))) return whole();
+			return Interval(1.0 / tan(a.hi), 1.0 / tan(a.lo));
+		}
+		if (e.token == "arctg") return Interval(atan(a.lo), atan(a.hi));
+		if (e.token == "arcctg") return Interval((PI) / 2.0 - atan(a.hi), (PI) / 2.0 - atan(a.lo));
+		if (e.token == "e") return Interval(exp(a.lo), exp(a.hi));
+		if (e.token == "ln" || e.token == "lg") {
+			if (a.hi <= 0) return Interval(NaN, NaN);
+			double lo = a.lo > 0 ? log(a.lo) : -Inf, hi = log(a.hi);
+			if (e.token == "ln") return Interval(lo, hi);
+			return Interval(lo / log(10.0), hi / log(10.0));
+		}
+
+		throw std::runtime_error("Unknown unary operator");
+	}
+
+	case 0:
+		if (e.token == "x") return x;
+		return Interval(strtod(e.token.c_str(), nullptr));
+	}
+
+	throw std::runtime_error("Unknown expression type");
+}
+
+static void subdivide(Parser& p, const Expression& e, double a, double b, double pixel,
+	std::vector<double>& xs, std::vector<double>& ys) {
+	auto range = p.eval(e, Interval(a, b));
+	// Keep splitting until the range fits in a pixel or the step is one pixel wide
+	if (!(range.width() <= pixel) && b - a > pixel) {
+		double m = (a + b) / 2;
+		subdivide(p, e, a, m, pixel, xs, ys);
+		subdivide(p, e, m, b, pixel, xs, ys);
+		return;
+	}
+	p.ValueX = b;
+	double y = p.eval(e);
+	if (std::isfinite(y)) {
+		xs.push_back(b);
+		ys.push_back(y);
+	}
+}
+
+void PlotAdaptive(Parser& p, const Expression& e, double a, double b, double pixel,
+	std::vector<double>& xs, std::vector<double>& ys) {
+	xs.clear();
+	ys.clear();
+	if (!(pixel > 0) || !(b > a))
+		return;
+	p.ValueX = a;
+	double y = p.eval(e);
+	if (std::isfinite(y)) {
+		xs.push_back(a);
+		ys.push_back(y);
+	}
+	subdivide(p, e, a, b, pixel, xs, ys);
+}
@@ -9,6 +9,16 @@
 
 #pragma once
 
+struct Interval {
+	Interval() : lo(0), hi(0) {}
+	Interval(double v) : lo(v), hi(v) {}
+	Interval(double lo, double hi) : lo(lo), hi(hi) {}
+	double width() const { return hi - lo; }
+
+	double lo;
+	double hi;
+};
+
 struct Expression {
 	Expression(std::string token) : token(token) {}
 	Expression(std::string token, Expression a) : token(token), args{ a } {}
@@ -20,7 +30,21 @@ struct Expression {
 
 class Parser {
 public:
-	explicit Parser(CString inputstr,double x) : Cstrinput(inputstr), ValueX(x)
+	explicit Parser(CString inputstr,double x) : Cstrinput(inputstr), ValueX(x), SymbolicX(false)
+	{
+		init();
+	}
+	// Keeps x as a variable node, so the tree is parsed once and evaluated for any x
+	explicit Parser(CString inputstr) : Cstrinput(inputstr), ValueX(0), SymbolicX(true)
+	{
+		init();
+	}
+	Expression parse();
+	double eval(const Expression& e);
+	// Encloses the range of e over x (interval arithmetic)
+	Interval eval(const Expression& e, const Interval& x);
+private:
+	void init()
 	{
 		strcpy_s(buff, CT2A(Cstrinput));
 		int i = 0;
@@ -30,9 +54,6 @@ public:
 		}
 		input = buff;
 	}
-	Expression parse();
-	double eval(const Expression& e);
-private:
 	std::string parse_token();
 	Expression parse_simple_expression();
 	Expression parse_binary_expression(int min_priority);
@@ -41,4 +62,9 @@ private:
 	CString Cstrinput;
 public:
 	double ValueX;
-};
\ No newline at end of file
+	bool SymbolicX;
+};
+
+// Samples e over [a, b], subdividing only where its range over a step exceeds pixel
+void PlotAdaptive(Parser& p, const Expression& e, double a, double b, double pixel,
+	std::vector<double>& xs, std::vector<double>& ys);
\ No newline at end of file